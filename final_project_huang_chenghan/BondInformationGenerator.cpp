@@ -1,2 +1,26 @@
+#include "DataGenerator.hpp"
+#include "products.hpp"
+#include "tradebookingservice.hpp"
+#include "positionservice.hpp"
+#include "riskservice.hpp"
+#include <cstdlib>
 
+void BondInformationGenerator() {
+    std::vector<float> BondCoupon = {
+            static_cast<float>(.8775 / 100.), static_cast<float>(.875 / 100.), static_cast<float>(1.125 / 100.),
+            static_cast<float>(2.375 / 100.), static_cast<float>(6.75 / 100.), static_cast<float>(6.25 / 100.)};
+    std::vector <date> BondMaturity = {date(2018, 10, 12), date(2019, 07, 19), date(2021, 11, 12),
+                                       date(2022, 01, 13), date(2029, 11, 15), date(2032, 07, 15)};
 
+    auto bondProductService = BondProductService::Generate_Instance();
+    auto bondPositionService = PositionService<Bond>::Generate_Instance();
+    auto bondRiskService = RiskService<Bond>::Generate_Instance();
+    for (int i = 0; i < 6; ++i) {
+        Bond bond_tmp(CUSIP_CODE[i], CUSIP, "T", BondCoupon[i], BondMaturity[i]);
+        Position <Bond> position_tmp(bond_tmp);
+        PV01 <Bond> pv01_tmp(bond_tmp, rand() % 1 / 100000., position_tmp.GetAggregatePosition());
+        bondProductService->Add(bond_tmp);
+        bondPositionService->AddPosition(position_tmp);
+        bondRiskService->Add(pv01_tmp);
+    }
+}
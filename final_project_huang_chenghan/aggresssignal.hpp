@@ -0,0 +1,229 @@
+/**
+* aggresssignal.hpp
+* Order book features and the signals deciding when, on which side and how much to aggress.
+*
+* @author Chenghan Huang
+*/
+#ifndef AGGRESS_SIGNAL_HPP
+#define AGGRESS_SIGNAL_HPP
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include "products.hpp"
+#include "marketdataservice.hpp"
+
+using namespace std;
+
+/**
+* Features of one order book, computed in a single pass over both stacks.
+* Imbalance is (bid depth - offer depth) / total depth over the full book, in [-1, 1];
+* the microprice is the touch prices weighted by the opposite touch size.
+*/
+struct BookFeatures
+{
+	double bidPrice;
+	double offerPrice;
+	long bidTouchSize;
+	long offerTouchSize;
+	long bidDepth;
+	long offerDepth;
+	int32_t spreadTicks;
+	double imbalance;
+	double microprice;
+};
+
+/**
+* What a signal decided: aggress on side at price for quantity.
+*/
+struct AggressDecision
+{
+	PricingSide side;
+	double price;
+	long quantity;
+};
+
+// Compute the features of an order book; false if either side is empty
+template<typename T>
+bool ComputeBookFeatures(const OrderBook<T> &orderbook, BookFeatures &features)
+{
+	const vector<Order> &bidStack = orderbook.GetBidStack();
+	const vector<Order> &offerStack = orderbook.GetOfferStack();
+	if (bidStack.empty() || offerStack.empty()) return false;
+
+	features.bidPrice = bidStack[0].GetPrice();
+	features.bidTouchSize = 0;
+	features.bidDepth = 0;
+	for (int i = 0; i < bidStack.size(); i++)
+	{
+		const Order &order = bidStack[i];
+		if (order.GetPrice() > features.bidPrice)
+		{
+			features.bidPrice = order.GetPrice();
+			features.bidTouchSize = 0;
+		}
+		if (order.GetPrice() == features.bidPrice) features.bidTouchSize += order.GetQuantity();
+		features.bidDepth += order.GetQuantity();
+	}
+
+	features.offerPrice = offerStack[0].GetPrice();
+	features.offerTouchSize = 0;
+	features.offerDepth = 0;
+	for (int i = 0; i < offerStack.size(); i++)
+	{
+		const Order &order = offerStack[i];
+		if (order.GetPrice() < features.offerPrice)
+		{
+			features.offerPrice = order.GetPrice();
+			features.offerTouchSize = 0;
+		}
+		if (order.GetPrice() == features.offerPrice) features.offerTouchSize += order.GetQuantity();
+		features.offerDepth += order.GetQuantity();
+	}
+
+	features.spreadTicks = (int32_t)lround((features.offerPrice - features.bidPrice) * TICKS_PER_POINT);
+	long depth = features.bidDepth + features.offerDepth;
+	features.imbalance = (depth > 0 ? (double)(features.bidDepth - features.offerDepth) / depth : 0);
+	long touch = features.bidTouchSize + features.offerTouchSize;
+	features.microprice = (touch > 0 ?
+		(features.bidPrice * features.offerTouchSize + features.offerPrice * features.bidTouchSize) / touch :
+		(features.bidPrice + features.offerPrice) / 2);
+	return true;
+}
+
+/**
+* The original rule: aggress whenever the touch is tighter than 1/32nd, alternating
+* between buying at the bid and selling at the offer, for the size at the touch.
+*/
+class TopOfBookSignal
+{
+
+public:
+
+	TopOfBookSignal()
+	{
+		side = BID;
+	}
+
+	bool Decide(const BookFeatures &features, AggressDecision &decision)
+	{
+		if (abs(features.bidPrice - features.offerPrice) >= 1.0 / 32) return false;
+		decision.side = side;
+		decision.price = (side == BID ? features.bidPrice : features.offerPrice);
+		decision.quantity = (side == BID ? features.bidTouchSize : features.offerTouchSize);
+		side = (side == BID ? OFFER : BID);
+		return true;
+	}
+
+private:
+	PricingSide side;
+
+};
+
+/**
+* Aggress in the direction of the full-depth imbalance: buy the offer when the bid side
+* holds at least minImbalance more of the book, sell the bid in the opposite case.
+* Only trades when the spread is at most maxSpreadTicks; size is the opposite touch,
+* capped at maxQuantity.
+*/
+class ImbalanceSignal
+{
+
+public:
+
+	ImbalanceSignal()
+	{
+		maxSpreadTicks = 8;
+		minImbalance = 0.2;
+		maxQuantity = 10000000;
+	}
+
+	// Set the signal parameters
+	void SetParameters(int32_t _maxSpreadTicks, double _minImbalance, long _maxQuantity)
+	{
+		maxSpreadTicks = _maxSpreadTicks;
+		minImbalance = _minImbalance;
+		maxQuantity = _maxQuantity;
+	}
+
+	bool Decide(const BookFeatures &features, AggressDecision &decision)
+	{
+		if (features.spreadTicks > maxSpreadTicks) return false;
+		if (features.imbalance >= minImbalance)
+		{
+			decision.side = BID;
+			decision.price = features.offerPrice;
+			decision.quantity = (features.offerTouchSize < maxQuantity ? features.offerTouchSize : maxQuantity);
+			return true;
+		}
+		if (features.imbalance <= -minImbalance)
+		{
+			decision.side = OFFER;
+			decision.price = features.bidPrice;
+			decision.quantity = (features.bidTouchSize < maxQuantity ? features.bidTouchSize : maxQuantity);
+			return true;
+		}
+		return false;
+	}
+
+private:
+	int32_t maxSpreadTicks;
+	double minImbalance;
+	long maxQuantity;
+
+};
+
+/**
+* Aggress when the microprice leans at least minEdgeTicks away from the mid: buy the offer
+* when it leans up, sell the bid when it leans down. Only trades when the spread is at most
+* maxSpreadTicks; size is the opposite touch, capped at maxQuantity.
+*/
+class MicropriceSignal
+{
+
+public:
+
+	MicropriceSignal()
+	{
+		maxSpreadTicks = 8;
+		minEdgeTicks = 1;
+		maxQuantity = 10000000;
+	}
+
+	// Set the signal parameters
+	void SetParameters(int32_t _maxSpreadTicks, double _minEdgeTicks, long _maxQuantity)
+	{
+		maxSpreadTicks = _maxSpreadTicks;
+		minEdgeTicks = _minEdgeTicks;
+		maxQuantity = _maxQuantity;
+	}
+
+	bool Decide(const BookFeatures &features, AggressDecision &decision)
+	{
+		if (features.spreadTicks > maxSpreadTicks) return false;
+		double edgeTicks = (features.microprice - (features.bidPrice + features.offerPrice) / 2) * TICKS_PER_POINT;
+		if (edgeTicks >= minEdgeTicks)
+		{
+			decision.side = BID;
+			decision.price = features.offerPrice;
+			decision.quantity = (features.offerTouchSize < maxQuantity ? features.offerTouchSize : maxQuantity);
+			return true;
+		}
+		if (edgeTicks <= -minEdgeTicks)
+		{
+			decision.side = OFFER;
+			decision.price = features.bidPrice;
+			decision.quantity = (features.bidTouchSize < maxQuantity ? features.bidTouchSize : maxQuantity);
+			return true;
+		}
+		return false;
+	}
+
+private:
+	int32_t maxSpreadTicks;
+	double minEdgeTicks;
+	long maxQuantity;
+
+};
+
+#endif
@@ -10,6 +10,9 @@
 #include "soa.hpp"
 //#include "marketdataservice.hpp"
 #include "executionservice.hpp"
+#include "aggresssignal.hpp"
+#include "timerwheel.hpp"
+#include "arena.hpp"
 //#include "products.hpp"
 #include <iostream>
 #include <stdlib.h>
@@ -17,6 +20,9 @@
 
 using namespace std;
 
+// How a parent order is worked
+enum SlicingAlgo { NO_SLICING, TWAP, ICEBERG };
+
 template<typename T>
 class AlgoExecutionOrder
 {
@@ -26,13 +32,12 @@ public:
 	AlgoExecutionOrder() {}
 
 	// ctor
-	AlgoExecutionOrder(ExecutionOrder<T> _executionorder)
+	AlgoExecutionOrder(ExecutionOrder<T> _executionorder) :
+		executionorder(std::move(_executionorder))
 	{
-		product = _executionorder.GetProduct();
-		executionorder = _executionorder;
 	}
 
-	ExecutionOrder<T> GetExecutionOrder()
+	const ExecutionOrder<T>& GetExecutionOrder() const
 	{
 		return executionorder;
 	}
@@ -40,88 +45,281 @@ public:
 	// Get the product
 	const T& GetProduct() const
 	{
-		return product;
+		return executionorder.GetProduct();
 	}
 
 private:
-	T product;
 	ExecutionOrder<T> executionorder;
 };
 
+/**
+* A parent order worked through child orders, with its sent, working, filled and cancelled quantity.
+* Type T is the product type.
+*/
 template<typename T>
-class AlgoExecutionService : public Service<string, AlgoExecutionOrder<T> >
+class ParentOrder
+{
+
+public:
+
+	ParentOrder() {}
+
+	// ctor for a parent order
+	ParentOrder(const ExecutionOrder<T> &_order, SlicingAlgo _algo)
+	{
+		order = _order;
+		algo = _algo;
+		sentQuantity = 0;
+		filledQuantity = 0;
+		cancelledQuantity = 0;
+		childCount = 0;
+	}
+
+	// Get the parent order
+	const ExecutionOrder<T>& GetOrder() const
+	{
+		return order;
+	}
+
+	// Get the slicing algorithm
+	SlicingAlgo GetAlgo() const
+	{
+		return algo;
+	}
+
+	// Get the total quantity to execute
+	long GetQuantity() const
+	{
+		return order.GetVisibleQuantity();
+	}
+
+	// Get the quantity not yet sent in a child order
+	long GetUnsentQuantity() const
+	{
+		return GetQuantity() - sentQuantity;
+	}
+
+	// Get the quantity sent in child orders and neither filled nor cancelled
+	long GetWorkingQuantity() const
+	{
+		return sentQuantity - filledQuantity - cancelledQuantity;
+	}
+
+	// Get the filled quantity
+	long GetFilledQuantity() const
+	{
+		return filledQuantity;
+	}
+
+	// Get the quantity of child orders cancelled unfilled
+	long GetCancelledQuantity() const
+	{
+		return cancelledQuantity;
+	}
+
+	// Get the number of child orders sent
+	int GetChildCount() const
+	{
+		return childCount;
+	}
+
+	// Record a child order sent for quantity
+	void AddChild(long quantity)
+	{
+		sentQuantity += quantity;
+		childCount++;
+	}
+
+	// Record a fill of a child order
+	void AddFill(long quantity)
+	{
+		filledQuantity += quantity;
+	}
+
+	// Record quantity of a child order cancelled unfilled
+	void AddCancel(long quantity)
+	{
+		cancelledQuantity += quantity;
+	}
+
+private:
+	ExecutionOrder<T> order;
+	SlicingAlgo algo;
+	long sentQuantity;
+	long filledQuantity;
+	long cancelledQuantity;
+	int childCount;
+};
+
+/**
+* Algo execution service turning order book opportunities into execution orders.
+* The Signal decides from the book features whether, on which side and how much to aggress;
+* it is a template parameter so the per-book decision is resolved and inlined at compile time.
+* Parent orders are sent whole, or sliced into child orders: TWAP sends sliceCount equal
+* slices sliceInterval ticks apart, ICEBERG shows displaySize at a time and sends the next
+* child once the working one is filled. One tick is one OnTimer() call. A parent leaves
+* ParentOrderMap once it has nothing working and nothing left to send.
+* A child whose remainder rests on a venue is filled later, by the venue's fills on it; those
+* arrive from inside the venue's matching, so their parent is settled on the next tick rather
+* than sending its next child into the venue from there.
+* Keyed on product identifier.
+* Type T is the product type, Signal the aggressing signal.
+*/
+template<typename T, typename Signal = TopOfBookSignal>
+class AlgoExecutionService : public Service<string, AlgoExecutionOrder<T> >, public FillListener<T>
 {
 public:
+	typedef map<IdType, ParentOrder<T>, less<IdType>, PoolAllocator<pair<const IdType, ParentOrder<T>>>> ParentMap;
+
 	map<string, AlgoExecutionOrder<T>> AlgoOrderMap;
+	ParentMap ParentOrderMap;    // parents being worked, nodes from the order pool
+	map<IdType, IdType> RestingChildMap;    // parent of each order resting on a venue, by its order id
 	vector<ServiceListener<AlgoExecutionOrder<T>>*> ListenerList;
-	PricingSide pricingside;
-	int orderID;
 
 	AlgoExecutionService()
 	{
-		pricingside = BID;
-		orderID = 0;
+		algo = NO_SLICING;
+		sliceCount = 1;
+		sliceInterval = 1;
+		displaySize = 1000000;
 	}
 
-	static AlgoExecutionService<T>* Generate_Instance()
+	static AlgoExecutionService<T, Signal>* Generate_Instance()
 	{
-		static AlgoExecutionService<T> instance;
+		static AlgoExecutionService<T, Signal> instance;
 		return &instance;
 	}
 
-	bool Aggress(BidOffer &_bidoffer)
+	// Get the signal, e.g. to set its parameters
+	Signal& GetSignal()
 	{
-		Order bid = _bidoffer.GetBidOrder();
-		Order offer = _bidoffer.GetOfferOrder();
-		double bidPrice = bid.GetPrice();
-		double offerPrice = offer.GetPrice();
-		if (abs(bidPrice - offerPrice) < 1.0 / 32)
+		return signal;
+	}
+
+	// Run the signal on an order book and send an execution order if it decides to aggress
+	bool Aggress(const OrderBook<T> &_orderbook)
+	{
+		BookFeatures features;
+		AggressDecision decision;
+		if (!ComputeBookFeatures(_orderbook, features)) return false;
+		if (!signal.Decide(features, decision)) return false;
+		ConvertToExecutionOrder(_orderbook.GetProduct(), decision);
+		return true;
+	}
+
+	ExecutionOrder<T> ConvertToExecutionOrder(const T &_product, const AggressDecision &_decision)
+	{
+		IdType id = IdGenerator::Orders().Next();
+		ExecutionOrder<T> executionorder(_product, _decision.side, id, MARKET, _decision.price, _decision.quantity, _decision.quantity, IdGenerator::INVALID_ID, false);
+		AlgoExecutionOrder<T> algoorder(executionorder);
+
+		if (algo == NO_SLICING)
 		{
-			return true;
+			PushToListeners(algoorder);
 		}
 		else
 		{
-			return false;
+			ParentOrder<T> &parent = ParentOrderMap[id] = ParentOrder<T>(executionorder, algo);
+			SendChild(parent);
 		}
+
+		return executionorder;
 	}
 
-	ExecutionOrder<T> ConvertToExecutionOrder(T &_product, BidOffer &_bidoffer)
+	// Work new parent orders with _algo: TWAP in _sliceCount slices _sliceInterval ticks apart,
+	// ICEBERG showing _displaySize at a time
+	void SetSlicing(SlicingAlgo _algo, int _sliceCount, int _sliceInterval, long _displaySize)
 	{
-		stringstream ss;
-		ss << orderID;
-		orderID++;
-		string id = ss.str();
-
-		Order executeorder = _bidoffer.GetOfferOrder();
-		if (pricingside == BID)
-		{
-			executeorder = _bidoffer.GetBidOrder();
-		}
-		ExecutionOrder<T> executionorder(_product, pricingside, id, MARKET, executeorder.GetPrice(), executeorder.GetQuantity(), executeorder.GetQuantity(), "0", false);
-		AlgoExecutionOrder<T> algoorder(executionorder);
+		algo = _algo;
+		sliceCount = (_sliceCount > 0 ? _sliceCount : 1);
+		sliceInterval = (_sliceInterval > 0 ? _sliceInterval : 1);
+		displaySize = (_displaySize > 0 ? _displaySize : 1);
+	}
 
-		if (pricingside == BID)
+	// Advance the slice schedule by one tick: settle the parents filled on a venue since the
+	// last tick, then send every TWAP slice that is due
+	void OnTimer()
+	{
+		for (int i = 0; i < SettledList.size(); i++)
 		{
-			pricingside = OFFER;
+			auto it = ParentOrderMap.find(SettledList[i]);
+			if (it != ParentOrderMap.end()) ChildSettled(it);
 		}
-		else
+		SettledList.clear();
+		SliceTimers.Advance([this](IdType parentId)
 		{
-			pricingside = BID;
-		}
+			auto it = ParentOrderMap.find(parentId);
+			if (it != ParentOrderMap.end() && it->second.GetUnsentQuantity() > 0) SendChild(it->second);
+		});
+	}
+
+	// Record a fill on a child order; an iceberg sends its next child once the working one is done
+	void OnFill(const ExecutionOrder<T> &_child, long _quantity)
+	{
+		if (!_child.IsChildOrder()) return;
+		auto it = ParentOrderMap.find(_child.GetParentOrderId());
+		if (it == ParentOrderMap.end()) return;
+		it->second.AddFill(_quantity);
+		ChildSettled(it);
+	}
+
+	// Record quantity of a child order cancelled unfilled, e.g. the remainder of an IOC child
+	void OnCancel(const ExecutionOrder<T> &_child, long _quantity)
+	{
+		if (!_child.IsChildOrder()) return;
+		auto it = ParentOrderMap.find(_child.GetParentOrderId());
+		if (it == ParentOrderMap.end()) return;
+		it->second.AddCancel(_quantity);
+		ChildSettled(it);
+	}
 
+	// Record that what a venue did not fill of a child order rests there as order _orderId: the
+	// child itself, or one of the venue orders it was routed as
+	void OnResting(const ExecutionOrder<T> &_child, IdType _orderId)
+	{
+		if (_child.IsChildOrder() && ParentOrderMap.count(_child.GetParentOrderId()) > 0) RestingChildMap[_orderId] = _child.GetParentOrderId();
+	}
+
+	// FillListener: a venue fill on a resting child counts against its parent, settled next tick;
+	// fills on arrival are left to OnFill above, from what the venue reported when it was sent
+	void OnFill(const ExchangeFill<T> &_fill) override
+	{
+		if (_fill.aggressor) return;
+		auto resting = RestingChildMap.find(_fill.orderId);
+		if (resting == RestingChildMap.end()) return;
+		IdType parentId = resting->second;
+		if (_fill.leavesQuantity == 0) RestingChildMap.erase(resting);
+		auto it = ParentOrderMap.find(parentId);
+		if (it == ParentOrderMap.end()) return;
+		it->second.AddFill(_fill.quantity);
+		SettledList.push_back(parentId);
+	}
+
+	// Get a parent order being worked; throws out_of_range once it is done
+	ParentOrder<T>& GetParentOrder(IdType _parentId)
+	{
+		return ParentOrderMap.at(_parentId);
+	}
+
+	// Get the number of TWAP slices still scheduled
+	uint64_t GetScheduledSlices() const
+	{
+		return SliceTimers.GetPending();
+	}
+
+	void PushToListeners(AlgoExecutionOrder<T> &_algoorder)
+	{
 		for (int i = 0; i < ListenerList.size(); i++)
 		{
 			ServiceListener<AlgoExecutionOrder<T>>* listener = ListenerList[i];
-			listener->ProcessAdd(algoorder);
+			listener->ProcessAdd(_algoorder);
 		}
-
-		return executionorder;
 	}
 
 	void ExecuteAlgoOrder(AlgoExecutionOrder<T> &_algoorder)
 	{
-		T BondProduct = _algoorder.GetProduct();
-		AlgoOrderMap.insert(pair<string, AlgoExecutionOrder<T>>(BondProduct.GetProductId(), _algoorder));
+		const string &id = _algoorder.GetProduct().GetProductId();
+		if (AlgoOrderMap.find(id) == AlgoOrderMap.end()) AlgoOrderMap.emplace(id, _algoorder);
 	}
 
 	virtual void OnMessage(AlgoExecutionOrder<T> &_algoorder) override
@@ -129,7 +327,7 @@ public:
 
 	virtual AlgoExecutionOrder<T>& GetData(string _id) override
 	{
-		return AlgoOrderMap[_id];
+		return AlgoOrderMap.at(_id);
 	}
 
 	virtual void AddListener(ServiceListener<AlgoExecutionOrder<T>>* _listener) override
@@ -145,6 +343,43 @@ public:
 private:
 	int maxvol_vis = 1000000;
 	int maxvol_hid = 10000000;
+	Signal signal;
+	SlicingAlgo algo;
+	int sliceCount;
+	int sliceInterval;
+	long displaySize;
+	TimerWheel<IdType> SliceTimers;
+	vector<IdType> SettledList;    // parents filled on a venue since the last tick
+
+	// With nothing of a parent working any more, drop it if nothing is left to send,
+	// otherwise send an iceberg's next child
+	void ChildSettled(typename ParentMap::iterator it)
+	{
+		ParentOrder<T> &parent = it->second;
+		if (parent.GetWorkingQuantity() > 0) return;
+		if (parent.GetUnsentQuantity() == 0) ParentOrderMap.erase(it);
+		else if (parent.GetAlgo() == ICEBERG) SendChild(parent);
+	}
+
+	// Send the next child order of a parent, scheduling the following TWAP slice
+	void SendChild(ParentOrder<T> &parent)
+	{
+		const ExecutionOrder<T> &order = parent.GetOrder();
+		long quantity = (parent.GetAlgo() == TWAP ? (parent.GetQuantity() + sliceCount - 1) / sliceCount : displaySize);
+		if (quantity > parent.GetUnsentQuantity()) quantity = parent.GetUnsentQuantity();
+		long hidden = (parent.GetAlgo() == ICEBERG ? parent.GetUnsentQuantity() - quantity : 0);
+
+		ExecutionOrder<T> child(order.GetProduct(), order.GetSide(), IdGenerator::Orders().Next(), (parent.GetAlgo() == TWAP ? MARKET : LIMIT),
+			order.GetPrice(), quantity, hidden, order.GetOrderId(), true);
+		parent.AddChild(quantity);
+		if (parent.GetAlgo() == TWAP && parent.GetUnsentQuantity() > 0)
+		{
+			SliceTimers.Schedule(sliceInterval, order.GetOrderId());
+		}
+
+		AlgoExecutionOrder<T> algoorder(child);
+		PushToListeners(algoorder);
+	}
 };
 
 //template<typename T>
@@ -5,39 +5,71 @@
 #include "soa.hpp"
 #include "executionservice.hpp"
 #include "algoexecutionservice.hpp"
+#include "smartorderrouter.hpp"
 #include <iostream>
 #include <stdlib.h>
 #include <time.h>
 
-template<typename T>
+template<typename T, typename Signal = TopOfBookSignal>
 class AlgoExecutionServiceListener : public ServiceListener<AlgoExecutionOrder<T>>
 {
 public:
-	static AlgoExecutionServiceListener<T>* Generate_Instance()
+	static AlgoExecutionServiceListener<T, Signal>* Generate_Instance()
 	{
-		static AlgoExecutionServiceListener<T> instance;
+		static AlgoExecutionServiceListener<T, Signal> instance;
 		return &instance;
 	}
 	// function overloading
 	void ProcessAdd(AlgoExecutionOrder<T> &data)
 	{
-		auto executionorder = data.GetExecutionOrder();
+		const ExecutionOrder<T> &executionorder = data.GetExecutionOrder();
 		_bondAlgoExecutionService->ExecuteAlgoOrder(data);
-		_bondExecutionService->ExecuteOrder(executionorder, CME);
+		const vector<RouteSlice> &slices = _bondSmartOrderRouter->Route(executionorder);
+		long filled = 0;
+		if (slices.size() == 1)
+		{
+			filled = Send(executionorder, executionorder, slices[0].venue);
+		}
+		else
+		{
+			// one child order per venue
+			for (int i = 0; i < slices.size(); i++)
+			{
+				double price = (executionorder.GetOrderType() == MARKET ? executionorder.GetPrice() : (double)slices[i].limitTicks / TICKS_PER_POINT);
+				ExecutionOrder<T> child(executionorder.GetProduct(), executionorder.GetSide(), IdGenerator::Orders().Next(),
+					executionorder.GetOrderType(), price, slices[i].quantity, 0, executionorder.GetOrderId(), true);
+				filled += Send(child, executionorder, slices[i].venue);
+			}
+		}
+		// only what the venues actually filled counts against the parent; all but a limit
+		// order's remainder, which rests on the venue, is cancelled there
+		_bondAlgoExecutionService->OnFill(executionorder, filled);
+		long unfilled = executionorder.GetVisibleQuantity() - filled;
+		if (unfilled > 0 && executionorder.GetOrderType() != LIMIT) _bondAlgoExecutionService->OnCancel(executionorder, unfilled);
 	}
 	void ProcessRemove(AlgoExecutionOrder<T> &data) {}  // No implementation
 	void ProcessUpdate(AlgoExecutionOrder<T> &data) {}  // No implementation
 
-	AlgoExecutionService<T>* GetService()
+	AlgoExecutionService<T, Signal>* GetService()
 	{
 		return _bondAlgoExecutionService;
 	}
 private:
-	AlgoExecutionService<T>* _bondAlgoExecutionService;
+	AlgoExecutionService<T, Signal>* _bondAlgoExecutionService;
 	ExecutionService<T>* _bondExecutionService;
+	SmartOrderRouter<T>* _bondSmartOrderRouter;
+	// Send _order, which is _algoorder or one of its per-venue children, to _venue; returns
+	// what filled on arrival. A limit order's remainder rests, to be filled later on the venue.
+	long Send(const ExecutionOrder<T> &_order, const ExecutionOrder<T> &_algoorder, Market _venue)
+	{
+		long filled = _bondExecutionService->ExecuteOrder(_order, _venue);
+		if (filled < _order.GetVisibleQuantity() && _order.GetOrderType() == LIMIT) _bondAlgoExecutionService->OnResting(_algoorder, _order.GetOrderId());
+		return filled;
+	}
 	AlgoExecutionServiceListener() 
 	{
-		_bondAlgoExecutionService = AlgoExecutionService<T>::Generate_Instance(); 
+		_bondSmartOrderRouter = SmartOrderRouter<T>::Generate_Instance();
+		_bondAlgoExecutionService = AlgoExecutionService<T, Signal>::Generate_Instance(); 
 		_bondExecutionService = ExecutionService<T>::Generate_Instance();
 	}
 };
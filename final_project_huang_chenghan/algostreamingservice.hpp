@@ -10,10 +10,13 @@
 #include "soa.hpp"
 #include "pricingservice.hpp"
 #include "streamingservice.hpp"
+#include "randomgenerator.hpp"
+#include "quoteskewservice.hpp"
+#include "pipeline.hpp"
 //#include "products.hpp"
 #include <iostream>
 #include <stdlib.h>
-#include <time.h>
+#include <atomic>
 
 template <typename T>
 class Price;
@@ -26,17 +29,16 @@ public:
 
 	AlgoPriceStream(){}
 
-	// ctor
-	AlgoPriceStream(PriceStream<T>& _pricestream)
+	// ctor; pass the stream as an rvalue to move it in
+	AlgoPriceStream(PriceStream<T> _pricestream) :
+		pricestream(std::move(_pricestream))
 	{
-		product = _pricestream.GetProduct();
-		pricestream = _pricestream;
 	}
 
 	// Get the product
 	const T& GetProduct() const
 	{
-		return product;
+		return pricestream.GetProduct();
 	}
 
 	const PriceStream<T>& GetPriceStream() const
@@ -45,7 +47,6 @@ public:
 	}
 
 private:
-	T product;
 	PriceStream<T> pricestream;
 };
 
@@ -62,40 +63,56 @@ public:
 		return &instance;
 	}
 
-	PriceStream<T> ConvertToPriceStream(Price<T> &_product)
+	// Reseed the stream sizes on every thread, e.g. with the seed of a run being replayed; each
+	// thread takes the new seed before its next draw
+	void Seed(uint64_t _seed)
+	{
+		baseSeed = _seed;
+		seedEpoch++;
+	}
+
+	void ConvertToPriceStream(Price<T> &_product)
+	{
+		Pipeline<> none;
+		ConvertToPriceStream(_product, none);
+	}
+
+	// Make the algo stream of a price and pass it down a static pipeline, then to the listeners
+	template<typename Next>
+	void ConvertToPriceStream(Price<T> &_product, Next &next)
 	{
-		srand((unsigned)time(NULL));
 		double bidP, askP, bidvol_vis, bidvol_hid, askvol_vis, askvol_hid;
 		bidP = _product.GetMid() - _product.GetBidOfferSpread();
 		askP = _product.GetMid() + _product.GetBidOfferSpread();
-		bidvol_vis = (rand() % (int)maxvol_vis) + 1;
-		bidvol_hid = (rand() % (int)(maxvol_hid - bidvol_vis)) + bidvol_vis + 1;
-		askvol_vis = (rand() % (int)maxvol_vis) + 1;
-		askvol_hid = (rand() % (int)(maxvol_hid - askvol_vis)) + askvol_vis + 1;
+		Xoshiro256 &rng = Rng();
+		bidvol_vis = rng.NextBounded(maxvol_vis) + 1;
+		bidvol_hid = rng.NextBounded((uint32_t)(maxvol_hid - bidvol_vis)) + bidvol_vis + 1;
+		askvol_vis = rng.NextBounded(maxvol_vis) + 1;
+		askvol_hid = rng.NextBounded((uint32_t)(maxvol_hid - askvol_vis)) + askvol_vis + 1;
+		_bondQuoteSkewService->Skew(GetRiskSlot(_product.GetProduct().GetProductId()), bidP, askP, bidvol_vis, bidvol_hid, askvol_vis, askvol_hid);
 		PriceStreamOrder bidorder(bidP, bidvol_vis, bidvol_hid, BID);
 		PriceStreamOrder askorder(askP, askvol_vis, askvol_hid, OFFER);
-		PriceStream<T> productstream(_product.GetProduct(), bidorder, askorder);
-		AlgoPriceStream<T> algostream(productstream);
+		AlgoPriceStream<T> algostream(PriceStream<T>(_product.GetProduct(), bidorder, askorder));
 
+		next.Push(algostream);
 		for (int i = 0; i < ListenerList.size(); i++)
 		{
 			ServiceListener<AlgoPriceStream<T>>* listener = ListenerList[i];
 			listener->ProcessAdd(algostream);
 		}
-		return productstream;
 	}
 
 	void AddAlgoStream(AlgoPriceStream<T> &_algostream)
 	{
-		T BondProduct = _algostream.GetProduct();
-		AlgoStreamMap.insert(pair<string, AlgoPriceStream<T>>(BondProduct.GetProductId(), _algostream));
+		const string &id = _algostream.GetProduct().GetProductId();
+		if (AlgoStreamMap.find(id) == AlgoStreamMap.end()) AlgoStreamMap.emplace(id, _algostream);
 	}
 
 	virtual void OnMessage(AlgoPriceStream<T> &data){}
 
 	virtual AlgoPriceStream<T>& GetData(string _id)
 	{
-		return AlgoStreamMap[_id];
+		return AlgoStreamMap.at(_id);
 	}
 
 	virtual void AddListener(ServiceListener<AlgoPriceStream<T>>* _listener)
@@ -111,6 +128,50 @@ public:
 private:
 	int maxvol_vis = 1000000;
 	int maxvol_hid = 10000000;
+	atomic<uint64_t> baseSeed{0x5eed5eed5eed5eedULL};
+	atomic<uint64_t> threadCount{0};
+	atomic<uint64_t> seedEpoch{0};    // bumped by every Seed
+	QuoteSkewService<T>* _bondQuoteSkewService = QuoteSkewService<T>::Generate_Instance();
+
+	// Get the calling thread's number, in the order threads first draw
+	uint64_t ThreadIndex()
+	{
+		thread_local uint64_t index = threadCount++;
+		return index;
+	}
+
+	// Get the seed of the calling thread: the base seed for the first thread, then one stream per thread
+	uint64_t ThreadSeed()
+	{
+		return baseSeed + ThreadIndex() * 0x9e3779b97f4a7c15ULL;
+	}
+
+	// Get the calling thread's generator, so threads never share generator state; it is
+	// reseeded first if Seed was called since the thread last drew
+	Xoshiro256& Rng()
+	{
+		thread_local Xoshiro256 rng(ThreadSeed());
+		thread_local uint64_t epoch = 0;
+		uint64_t current = seedEpoch.load();
+		if (current != epoch)
+		{
+			epoch = current;
+			rng.Seed(ThreadSeed());
+		}
+		return rng;
+	}
+
+	// Get the skew slot of a product, cached per thread so streaming threads never share the cache
+	const SeqLock<QuoteRiskState>* GetRiskSlot(const string &id)
+	{
+		thread_local map<string, const SeqLock<QuoteRiskState>*> RiskSlotMap;
+		auto it = RiskSlotMap.find(id);
+		if (it == RiskSlotMap.end())
+		{
+			it = RiskSlotMap.insert(pair<string, const SeqLock<QuoteRiskState>*>(id, _bondQuoteSkewService->GetSlot(id))).first;
+		}
+		return it->second;
+	}
 };
 
 #endif
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include "soa.hpp"
 #include "streamingservice.hpp"
 #include "algostreamingservice.hpp"
+#include "pipeline.hpp"
 #include <iostream>
 #include <stdlib.h>
 #include <time.h>
@@ -20,8 +21,7 @@ public:
 
 	void ProcessAdd(AlgoPriceStream<T> &data)
 	{
-		PriceStream<T> pricestream = data.GetPriceStream();
-		_bondStreamingService->PublishPrice(pricestream);
+		_bondStreamingService->PublishPrice(data.GetPriceStream());
 	}
 
 	void ProcessRemove(AlgoPriceStream<T> &data) {}
@@ -43,4 +43,34 @@ private:
 	}
 };
 
+/**
+* Static pipeline stage doing the work of AlgoStreamingServiceListener: algo stream -> streaming.
+* Flushing it publishes the streams the StreamingService throttle held back.
+* Type T is the product type.
+*/
+template<typename T>
+class AlgoStreamingStage
+{
+public:
+	AlgoStreamingStage()
+	{
+		_bondStreamingService = StreamingService<T>::Generate_Instance();
+	}
+
+	template<typename Next>
+	void Process(AlgoPriceStream<T> &data, Next &next)
+	{
+		_bondStreamingService->PublishPrice(data.GetPriceStream(), next);
+	}
+
+	template<typename Next>
+	void Flush(Next &next)
+	{
+		_bondStreamingService->Flush(next);
+	}
+
+private:
+	StreamingService<T>* _bondStreamingService;
+};
+
 #endif
\ No newline at end of file
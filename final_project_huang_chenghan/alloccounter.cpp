@@ -0,0 +1,42 @@
+/**
+* alloccounter.cpp
+* Replacement global operator new/delete counting the allocations of each thread.
+*
+* @author Chenghan Huang
+*/
+#include "alloccounter.hpp"
+#include <cstdlib>
+#include <new>
+
+// allocations made by this thread; trivially initialised, so usable from operator new
+static thread_local uint64_t allocationCount = 0;
+
+uint64_t AllocCounter::GetCount()
+{
+	return allocationCount;
+}
+
+// the array and sized forms of new and delete forward to these by default
+void* operator new(std::size_t size)
+{
+	allocationCount++;
+	void *memory = std::malloc(size == 0 ? 1 : size);
+	if (memory == nullptr) throw std::bad_alloc();
+	return memory;
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	allocationCount++;
+	return std::malloc(size == 0 ? 1 : size);
+}
+
+void operator delete(void *memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void *memory, const std::nothrow_t&) noexcept
+{
+	std::free(memory);
+}
@@ -0,0 +1,33 @@
+/**
+* alloccounter.hpp
+* Count of the heap allocations made by each thread, to measure allocations per message.
+*
+* @author Chenghan Huang
+*/
+#ifndef ALLOC_COUNTER_HPP
+#define ALLOC_COUNTER_HPP
+
+#include <cstdint>
+
+/**
+* Heap allocation counter. alloccounter.cpp replaces the global operator new to count every
+* allocation made by the calling thread, so taking the count before and after a feed is read
+* gives the allocations it cost on that thread alone, whatever other threads are doing.
+*/
+class AllocCounter
+{
+
+public:
+
+	// Get the number of allocations the calling thread has made so far
+	static uint64_t GetCount();
+
+	// Get the allocations per message since _start, the count taken before _messages messages
+	static double PerMessage(uint64_t _start, long _messages)
+	{
+		return (_messages > 0 ? (double)(GetCount() - _start) / _messages : 0.0);
+	}
+
+};
+
+#endif
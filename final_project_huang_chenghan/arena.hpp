@@ -0,0 +1,290 @@
+/**
+* arena.hpp
+* Arena and pool allocators keeping the per-message hot paths off malloc.
+*
+* @author Chenghan Huang
+*/
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+using namespace std;
+
+/**
+* Monotonic arena: allocation bumps a pointer through chunks that are kept for reuse, and
+* nothing is freed one object at a time. Rewind(mark) gives back everything allocated since
+* GetMark(), so a connector takes a mark before a row and rewinds after it; once the arena
+* has grown to fit the largest row it allocates nothing more from the heap.
+* Each thread has its own arena (ThreadLocal), so no locking.
+*/
+class MonotonicArena
+{
+
+public:
+
+	// Position in the arena to rewind to
+	struct Mark
+	{
+		size_t chunk;
+		size_t used;
+	};
+
+	explicit MonotonicArena(size_t _chunkSize = 64 * 1024) : chunkSize(_chunkSize), chunk(0), used(0) {}
+
+	~MonotonicArena()
+	{
+		for (size_t i = 0; i < ChunkList.size(); i++) ::operator delete(ChunkList[i].memory);
+	}
+
+	// The calling thread's arena
+	static MonotonicArena& ThreadLocal()
+	{
+		static thread_local MonotonicArena instance;
+		return instance;
+	}
+
+	// Allocate size bytes aligned to align (a power of two)
+	void* Allocate(size_t size, size_t align)
+	{
+		while (chunk < ChunkList.size())
+		{
+			size_t offset = (used + align - 1) & ~(align - 1);
+			if (offset + size <= ChunkList[chunk].size)
+			{
+				used = offset + size;
+				return ChunkList[chunk].memory + offset;
+			}
+			// on to the next chunk kept from earlier
+			chunk++;
+			used = 0;
+		}
+		Chunk fresh;
+		fresh.size = (size + align > chunkSize ? size + align : chunkSize);
+		fresh.memory = static_cast<char*>(::operator new(fresh.size));
+		ChunkList.push_back(fresh);
+		return Allocate(size, align);
+	}
+
+	// Get the current position
+	Mark GetMark() const
+	{
+		Mark mark = { chunk, used };
+		return mark;
+	}
+
+	// Give back everything allocated since mark was taken
+	void Rewind(const Mark &mark)
+	{
+		chunk = mark.chunk;
+		used = mark.used;
+	}
+
+	// Get the bytes held in chunks
+	size_t GetCapacity() const
+	{
+		size_t capacity = 0;
+		for (size_t i = 0; i < ChunkList.size(); i++) capacity += ChunkList[i].size;
+		return capacity;
+	}
+
+private:
+	struct Chunk
+	{
+		char *memory;
+		size_t size;
+	};
+
+	size_t chunkSize;
+	vector<Chunk> ChunkList;
+	size_t chunk;           // chunk being allocated from
+	size_t used;            // bytes used in it
+
+	MonotonicArena(const MonotonicArena&);
+	MonotonicArena& operator=(const MonotonicArena&);
+
+};
+
+/**
+* Scope rewinding the calling thread's arena when it ends, e.g. one per connector row.
+* Whatever was allocated from the arena in the scope must be gone by then.
+*/
+class ArenaScope
+{
+
+public:
+
+	ArenaScope() : arena(MonotonicArena::ThreadLocal()), mark(arena.GetMark()) {}
+
+	~ArenaScope()
+	{
+		arena.Rewind(mark);
+	}
+
+private:
+	MonotonicArena &arena;
+	MonotonicArena::Mark mark;
+
+	ArenaScope(const ArenaScope&);
+	ArenaScope& operator=(const ArenaScope&);
+
+};
+
+/**
+* Allocator over the calling thread's arena, for containers living within an ArenaScope.
+* Deallocation is a no-op; the memory comes back when the scope rewinds.
+* Type T is the value type.
+*/
+template<typename T>
+class ArenaAllocator
+{
+
+public:
+
+	typedef T value_type;
+
+	ArenaAllocator() {}
+
+	template<typename U>
+	ArenaAllocator(const ArenaAllocator<U>&) {}
+
+	T* allocate(size_t n)
+	{
+		return static_cast<T*>(MonotonicArena::ThreadLocal().Allocate(n * sizeof(T), alignof(T)));
+	}
+
+	void deallocate(T*, size_t) {}
+
+	template<typename U>
+	struct rebind
+	{
+		typedef ArenaAllocator<U> other;
+	};
+
+};
+
+template<typename T, typename U>
+bool operator==(const ArenaAllocator<T>&, const ArenaAllocator<U>&)
+{
+	return true;
+}
+
+template<typename T, typename U>
+bool operator!=(const ArenaAllocator<T>&, const ArenaAllocator<U>&)
+{
+	return false;
+}
+
+/**
+* Free list of fixed-size blocks, carved out of chunks of BLOCKS_PER_CHUNK at a time.
+* Each thread has its own pool per block size. Chunks are kept for the life of the process,
+* so a block freed on another thread than the one that allocated it just joins that thread's
+* free list.
+*/
+template<size_t Size, size_t Align>
+class FixedPool
+{
+
+public:
+
+	static const size_t BLOCKS_PER_CHUNK = 256;
+
+	// The calling thread's pool
+	static FixedPool& ThreadLocal()
+	{
+		static thread_local FixedPool instance;
+		return instance;
+	}
+
+	void* Allocate()
+	{
+		if (freeList == nullptr) Grow();
+		Block *block = freeList;
+		freeList = block->next;
+		return block;
+	}
+
+	void Deallocate(void *memory)
+	{
+		Block *block = static_cast<Block*>(memory);
+		block->next = freeList;
+		freeList = block;
+	}
+
+private:
+	union Block
+	{
+		Block *next;
+		alignas(Align) char storage[Size];
+	};
+
+	Block *freeList;
+
+	FixedPool() : freeList(nullptr) {}
+
+	void Grow()
+	{
+		Block *chunk = static_cast<Block*>(::operator new(sizeof(Block) * BLOCKS_PER_CHUNK));
+		for (size_t i = BLOCKS_PER_CHUNK; i-- > 0; )
+		{
+			chunk[i].next = freeList;
+			freeList = &chunk[i];
+		}
+	}
+
+};
+
+/**
+* Allocator drawing single objects from the thread's FixedPool of their size, for node based
+* containers (map, set, list) of long-lived objects such as booked trades and parent orders.
+* Allocations of more than one object, which node containers never make, go to operator new.
+* Type T is the value type.
+*/
+template<typename T>
+class PoolAllocator
+{
+
+public:
+
+	typedef T value_type;
+
+	PoolAllocator() {}
+
+	template<typename U>
+	PoolAllocator(const PoolAllocator<U>&) {}
+
+	T* allocate(size_t n)
+	{
+		if (n != 1) return static_cast<T*>(::operator new(n * sizeof(T)));
+		return static_cast<T*>(FixedPool<sizeof(T), alignof(T)>::ThreadLocal().Allocate());
+	}
+
+	void deallocate(T *p, size_t n)
+	{
+		if (n != 1) ::operator delete(p);
+		else FixedPool<sizeof(T), alignof(T)>::ThreadLocal().Deallocate(p);
+	}
+
+	template<typename U>
+	struct rebind
+	{
+		typedef PoolAllocator<U> other;
+	};
+
+};
+
+template<typename T, typename U>
+bool operator==(const PoolAllocator<T>&, const PoolAllocator<U>&)
+{
+	return true;
+}
+
+template<typename T, typename U>
+bool operator!=(const PoolAllocator<T>&, const PoolAllocator<U>&)
+{
+	return false;
+}
+
+#endif
@@ -0,0 +1,106 @@
+/**
+* aggresssignal_bench.cpp
+* Cost per book of the aggress decision: the old copy-the-stacks path against the book features and signals.
+*
+* @author Chenghan Huang
+*/
+#include "products.hpp"
+#include "marketdataservice.hpp"
+#include "aggresssignal.hpp"
+#include "benchmark.hpp"
+
+static const int BOOKS = 64;
+static const long ITERATIONS = 2000000;
+
+// Books five levels deep on each side; every other one is tighter than 1/32nd, so signals fire on half
+static vector<OrderBook<Bond>> MakeBooks(const Bond &bond)
+{
+	vector<OrderBook<Bond>> books;
+	for (int b = 0; b < BOOKS; b++)
+	{
+		double mid = 99 + (b % 16) / 256.;
+		double halfSpread = (b % 2 == 0 ? 1 / 256. : 1 / 32.);
+		vector<Order> bids;
+		vector<Order> offers;
+		for (int i = 0; i < 5; i++)
+		{
+			bids.push_back(Order(mid - halfSpread - i / 256., 1000000 * (i + 1 + b % 3), BID));
+			offers.push_back(Order(mid + halfSpread + i / 256., 1000000 * (i + 1 + b % 5), OFFER));
+		}
+		books.push_back(OrderBook<Bond>(bond, bids, offers));
+	}
+	return books;
+}
+
+// The decision as it was made before the signals: copy both stacks to find the touch,
+// allocate a BidOffer and aggress when the touch is tighter than 1/32nd
+static bool OldAggress(OrderBook<Bond> orderbook, PricingSide &side)
+{
+	vector<Order> bidStack = orderbook.GetBidStack();
+	vector<Order> offerStack = orderbook.GetOfferStack();
+	double bestbidprice = bidStack[0].GetPrice();
+	double bestofferprice = offerStack[0].GetPrice();
+	Order bestbid, bestoffer;
+	for (int i = 0; i < bidStack.size(); i++)
+	{
+		if (bidStack[i].GetPrice() >= bestbidprice)
+		{
+			bestbidprice = bidStack[i].GetPrice();
+			bestbid = bidStack[i];
+		}
+	}
+	for (int i = 0; i < offerStack.size(); i++)
+	{
+		if (offerStack[i].GetPrice() <= bestofferprice)
+		{
+			bestofferprice = offerStack[i].GetPrice();
+			bestoffer = offerStack[i];
+		}
+	}
+	// the old path leaked this; it is freed here so a long run stays in memory
+	BidOffer *bidoffer = new BidOffer(bestbid, bestoffer);
+	bool aggress = abs(bidoffer->GetBidOrder().GetPrice() - bidoffer->GetOfferOrder().GetPrice()) < 1.0 / 32;
+	delete bidoffer;
+	if (aggress) side = (side == BID ? OFFER : BID);
+	return aggress;
+}
+
+template<typename Signal>
+static double MeasureSignal(const char *name, const vector<OrderBook<Bond>> &books, Signal &signal)
+{
+	return Measure(name, ITERATIONS, [&books, &signal](long i)
+	{
+		BookFeatures features;
+		AggressDecision decision;
+		bool aggress = ComputeBookFeatures(books[i % BOOKS], features) && signal.Decide(features, decision);
+		KeepValue(aggress);
+		KeepValue(decision);
+	});
+}
+
+int main()
+{
+	Bond bond("BENCH", CUSIP, "T", 0.02f, date(2030, 1, 15));
+	vector<OrderBook<Bond>> books = MakeBooks(bond);
+
+	PricingSide side = BID;
+	Measure("old path (stack copies, BidOffer, Aggress)", ITERATIONS, [&books, &side](long i)
+	{
+		bool aggress = OldAggress(books[i % BOOKS], side);
+		KeepValue(aggress);
+	});
+	Measure("ComputeBookFeatures only", ITERATIONS, [&books](long i)
+	{
+		BookFeatures features;
+		bool valid = ComputeBookFeatures(books[i % BOOKS], features);
+		KeepValue(valid);
+		KeepValue(features);
+	});
+	TopOfBookSignal topOfBook;
+	MeasureSignal("ComputeBookFeatures + TopOfBookSignal", books, topOfBook);
+	ImbalanceSignal imbalance;
+	MeasureSignal("ComputeBookFeatures + ImbalanceSignal", books, imbalance);
+	MicropriceSignal microprice;
+	MeasureSignal("ComputeBookFeatures + MicropriceSignal", books, microprice);
+	return 0;
+}
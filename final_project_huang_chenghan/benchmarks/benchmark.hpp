@@ -0,0 +1,35 @@
+/**
+* benchmark.hpp
+* Minimal timing loop for the benchmark executables: warm up, run, print nanoseconds per iteration.
+*
+* @author Chenghan Huang
+*/
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+
+// Keep value observable, so the compiler cannot drop the work that made it
+template<typename V>
+inline void KeepValue(const V &value)
+{
+	asm volatile("" : : "g"(&value) : "memory");
+}
+
+// Run body iterations times after iterations / 10 warm-up runs; prints and returns ns per iteration
+template<typename Body>
+double Measure(const char *name, long iterations, Body body)
+{
+	for (long i = 0; i < iterations / 10; i++) body(i);
+	auto start = std::chrono::steady_clock::now();
+	for (long i = 0; i < iterations; i++) body(i);
+	auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	double perIteration = (double)elapsed / iterations;
+	std::cout << std::left << std::setw(48) << name << std::right << std::fixed << std::setprecision(1)
+		<< std::setw(10) << perIteration << " ns" << std::endl;
+	return perIteration;
+}
+
+#endif
@@ -0,0 +1,103 @@
+/**
+* exchangesimulator_bench.cpp
+* Orders per second the exchange simulator matches on one core, on its book and through the ExecutionVenue.
+*
+* @author Chenghan Huang
+*/
+#include "products.hpp"
+#include "tradebookingservice.hpp"
+#include "executionservice.hpp"
+#include "exchangesimulator.hpp"
+#include "benchmark.hpp"
+
+static const int ORDERS = 1 << 16;
+static const long ITERATIONS = 5000000;
+static const int32_t MID_TICKS = 25600;
+
+/**
+* One order of the flow, in the terms MatchingBook::Submit takes.
+*/
+struct BenchOrder
+{
+	PricingSide side;
+	OrderType orderType;
+	int32_t priceTicks;
+	long quantity;
+};
+
+/**
+* Fill listener counting what it is told about, as a booking listener would see it.
+*/
+class CountingFillListener : public FillListener<Bond>
+{
+public:
+	long count = 0;
+
+	void OnFill(const ExchangeFill<Bond> &fill) override
+	{
+		count++;
+		KeepValue(fill);
+	}
+};
+
+// Half the orders rest a few ticks behind the mid and half cross it as IOC for the same sizes,
+// so the book stays a few levels deep on each side however long the flow runs
+static vector<BenchOrder> MakeFlow()
+{
+	vector<BenchOrder> flow(ORDERS);
+	uint32_t state = 12345;
+	for (int i = 0; i < ORDERS; i++)
+	{
+		state = state * 1664525 + 1013904223;
+		BenchOrder &order = flow[i];
+		order.side = ((state >> 8) & 1 ? BID : OFFER);
+		bool passive = ((state >> 9) & 1) != 0;
+		int32_t offset = 1 + (int32_t)((state >> 10) % 4);
+		order.orderType = (passive ? LIMIT : IOC);
+		order.priceTicks = (order.side == BID ? MID_TICKS - (passive ? offset : -4) : MID_TICKS + (passive ? offset : -4));
+		order.quantity = 1000000 * (1 + (long)((state >> 12) % 5));
+	}
+	return flow;
+}
+
+int main()
+{
+	IdGenerator::StartProcessSession(1);
+	Bond bond("BENCH", CUSIP, "T", 0.02f, date(2030, 1, 15));
+	vector<BenchOrder> flow = MakeFlow();
+	ExchangeSimulator<Bond> *exchange = ExchangeSimulator<Bond>::Generate_Instance();
+
+	MatchingBook<Bond> *book = exchange->GetBook(bond, CME);
+	double bookNs = Measure("MatchingBook::Submit, no fill listener", ITERATIONS, [&flow, book](long i)
+	{
+		const BenchOrder &order = flow[i % ORDERS];
+		SubmitResult result = book->Submit(order.side, order.orderType, order.priceTicks, order.quantity, IdGenerator::Make(1, i + 1));
+		KeepValue(result);
+	});
+
+	// the same flow as execution orders, sent through the venue interface with a listener attached
+	vector<ExecutionOrder<Bond>> orders;
+	orders.reserve(ORDERS);
+	for (int i = 0; i < ORDERS; i++)
+	{
+		orders.push_back(ExecutionOrder<Bond>(bond, flow[i].side, IdGenerator::Make(1, i + 1), flow[i].orderType,
+			flow[i].priceTicks / (double)TICKS_PER_POINT, flow[i].quantity, 0, 0, false));
+	}
+	CountingFillListener fills;
+	exchange->AddListener(&fills);
+	ExecutionVenue<Bond> *venue = exchange;
+	double venueNs = Measure("ExecutionVenue::Execute, one fill listener", ITERATIONS, [&orders, venue](long i)
+	{
+		ExecutionReport report = venue->Execute(orders[i % ORDERS], ESPEED);
+		KeepValue(report);
+	});
+
+	if (fills.count == 0)
+	{
+		std::cout << "the flow never traded" << std::endl;
+		return 1;
+	}
+	std::cout << "orders per second on one core: " << (long)(1e9 / bookNs) << " on the book, "
+		<< (long)(1e9 / venueNs) << " through the venue" << std::endl;
+	return 0;
+}
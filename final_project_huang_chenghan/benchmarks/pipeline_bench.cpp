@@ -0,0 +1,90 @@
+/**
+* pipeline_bench.cpp
+* Cost per price of the pricing chain wired as a static pipeline against the same chain wired through listeners.
+*
+* @author Chenghan Huang
+*/
+#include "products.hpp"
+#include "tradebookingservice.hpp"
+#include "positionservice.hpp"
+#include "riskservice.hpp"
+#include "pricingservice.hpp"
+#include "pricingservicelistener.hpp"
+#include "algostreamingservice.hpp"
+#include "algostreamingservicelistener.hpp"
+#include "streamingservice.hpp"
+#include "pipeline.hpp"
+#include "benchmark.hpp"
+
+static const int PRODUCTS = 6;
+static const long ITERATIONS = 1000000;
+
+// Last pipeline stage: counts the streams instead of writing streaming.txt
+class CountingStage : public PipelineStage
+{
+public:
+	long count = 0;
+
+	template<typename Next>
+	void Process(PriceStream<Bond> &data, Next &next)
+	{
+		count++;
+		KeepValue(data);
+	}
+};
+
+// Last listener: counts the streams instead of writing streaming.txt
+class CountingListener : public ServiceListener<PriceStream<Bond>>
+{
+public:
+	long count = 0;
+
+	void ProcessAdd(PriceStream<Bond> &data) override
+	{
+		count++;
+		KeepValue(data);
+	}
+
+	void ProcessRemove(PriceStream<Bond> &data) override {}
+	void ProcessUpdate(PriceStream<Bond> &data) override {}
+};
+
+int main()
+{
+	BondProductService *productService = BondProductService::Generate_Instance();
+	vector<Price<Bond>> prices;
+	for (int p = 0; p < PRODUCTS; p++)
+	{
+		Bond bond("BENCH" + to_string(p), CUSIP, "T", 0.02f, date(2020 + p, 1, 15));
+		productService->Add(bond);
+		const Bond &product = productService->GetData(bond.GetProductId());
+		for (int i = 0; i < 16; i++) prices.push_back(Price<Bond>(&product, 25600 + i, 2 + i % 3));
+	}
+	PricingService<Bond> *pricingService = PricingService<Bond>::Generate_Instance();
+
+	// price -> algo stream -> stream, every hop a direct call; run first, while no listener is attached
+	Pipeline<PricingStage<Bond>, AlgoStreamingStage<Bond>, CountingStage> pipeline;
+	double pipelineNs = Measure("static pipeline", ITERATIONS, [&prices, pricingService, &pipeline](long i)
+	{
+		pricingService->OnMessage(prices[i % prices.size()], pipeline);
+	});
+
+	// the same chain through the listener lists
+	CountingListener counter;
+	pricingService->AddListener(PricingServiceListener<Bond>::Generate_Instance());
+	AlgoStreamingService<Bond>::Generate_Instance()->AddListener(AlgoStreamingServiceListener<Bond>::Generate_Instance());
+	StreamingService<Bond>::Generate_Instance()->AddListener(&counter);
+	double listenerNs = Measure("listeners", ITERATIONS, [&prices, pricingService](long i)
+	{
+		pricingService->OnMessage(prices[i % prices.size()]);
+	});
+
+	long expected = ITERATIONS + ITERATIONS / 10;
+	if (pipeline.GetRest().GetRest().GetStage().count != expected || counter.count != expected)
+	{
+		std::cout << "a chain dropped streams" << std::endl;
+		return 1;
+	}
+	std::cout << "listeners cost " << listenerNs - pipelineNs << " ns more per price" << std::endl;
+	return 0;
+}
@@ -0,0 +1,468 @@
+/**
+* exchangesimulator.hpp
+* In-process matching engine standing in for the BROKERTEC, ESPEED and CME venues.
+*
+* @author Chenghan Huang
+*/
+#ifndef EXCHANGE_SIMULATOR_HPP
+#define EXCHANGE_SIMULATOR_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include "soa.hpp"
+#include "products.hpp"
+#include "marketdataservice.hpp"
+#include "executionservice.hpp"
+
+using namespace std;
+
+// Outcome of an order sent to the exchange
+enum ExchangeOrderStatus { ORDER_FILLED, ORDER_PARTIALLY_FILLED, ORDER_RESTING, ORDER_CANCELLED, ORDER_REJECTED };
+
+/**
+* What happened to an order: its status, order id, the quantity filled on entry
+* and its average price in ticks, and for a resting order the handle to cancel it with.
+*/
+struct SubmitResult
+{
+	ExchangeOrderStatus status;
+	IdType orderId;
+	long filledQuantity;
+	double averagePriceTicks;
+	uint32_t handle;
+};
+
+/**
+* An order resting in a book, linked into the FIFO queue of its price level.
+*/
+struct OrderNode
+{
+	IdType orderId;
+	long quantity;
+	int32_t priceTicks;
+	PricingSide side;
+	bool live;
+	uint32_t prev;
+	uint32_t next;
+};
+
+/**
+* Pool of order nodes addressed by index. Freed nodes are kept on a free list and reused,
+* so a book in steady state does not allocate per order.
+*/
+class OrderNodePool
+{
+
+public:
+
+	static const uint32_t NIL = 0xffffffff;
+
+	// ctor for a pool with room for reserve nodes before it grows
+	explicit OrderNodePool(uint32_t reserve = 1024)
+	{
+		nodes.reserve(reserve);
+		freeHead = NIL;
+	}
+
+	// Get a free node
+	uint32_t Acquire()
+	{
+		if (freeHead != NIL)
+		{
+			uint32_t index = freeHead;
+			freeHead = nodes[index].next;
+			return index;
+		}
+		nodes.emplace_back();
+		return (uint32_t)(nodes.size() - 1);
+	}
+
+	// Return a node to the pool
+	void Release(uint32_t index)
+	{
+		nodes[index].live = false;
+		nodes[index].next = freeHead;
+		freeHead = index;
+	}
+
+	OrderNode& operator[](uint32_t index)
+	{
+		return nodes[index];
+	}
+
+	const OrderNode& operator[](uint32_t index) const
+	{
+		return nodes[index];
+	}
+
+	// Get the number of nodes ever allocated
+	size_t GetCapacity() const
+	{
+		return nodes.size();
+	}
+
+private:
+	vector<OrderNode> nodes;
+	uint32_t freeHead;
+
+};
+
+/**
+* Limit order book of one product on one venue, matching with price-time priority.
+* Each side is a vector of price levels sorted so the best level is at the back, where
+* nearly all activity happens; each level is a FIFO queue of pooled order nodes.
+*   LIMIT   trades up to its price and rests the remainder
+*   MARKET  trades at any price, the remainder is cancelled
+*   IOC     trades up to its price, the remainder is cancelled
+*   FOK     trades in full up to its price, or not at all
+* STOP orders are not supported and are rejected.
+* Type T is the product type.
+*/
+template<typename T>
+class MatchingBook
+{
+
+public:
+
+	// ctor for the book of _product on _venue, reporting fills to _listeners
+	MatchingBook(const T *_product, Market _venue, const vector<FillListener<T>*> *_listeners)
+	{
+		product = _product;
+		venue = _venue;
+		listeners = _listeners;
+	}
+
+	// Send an order; prices in ticks, the price of a MARKET order is ignored
+	SubmitResult Submit(PricingSide side, OrderType orderType, int32_t priceTicks, long quantity, IdType orderId)
+	{
+		SubmitResult result;
+		result.orderId = orderId;
+		result.filledQuantity = 0;
+		result.averagePriceTicks = 0;
+		result.handle = OrderNodePool::NIL;
+		if (quantity <= 0 || orderType == STOP)
+		{
+			result.status = ORDER_REJECTED;
+			return result;
+		}
+
+		bool anyPrice = (orderType == MARKET);
+		if (orderType == FOK && Available(side, priceTicks) < quantity)
+		{
+			result.status = ORDER_CANCELLED;
+			return result;
+		}
+
+		int64_t notionalTicks = 0;
+		long leaves = Match(side, anyPrice, priceTicks, quantity, orderId, notionalTicks);
+		result.filledQuantity = quantity - leaves;
+		if (result.filledQuantity > 0) result.averagePriceTicks = (double)notionalTicks / result.filledQuantity;
+		if (leaves == 0)
+		{
+			result.status = ORDER_FILLED;
+		}
+		else if (orderType == LIMIT)
+		{
+			result.handle = Rest(side, priceTicks, leaves, orderId);
+			result.status = ORDER_RESTING;
+		}
+		else
+		{
+			result.status = (result.filledQuantity > 0 ? ORDER_PARTIALLY_FILLED : ORDER_CANCELLED);
+		}
+		return result;
+	}
+
+	// Cancel a resting order by the handle and id it was given; false if it is no longer resting
+	bool Cancel(uint32_t handle, IdType orderId)
+	{
+		if (handle >= pool.GetCapacity()) return false;
+		OrderNode &node = pool[handle];
+		if (!node.live || node.orderId != orderId) return false;
+		vector<PriceLevel> &levels = (node.side == BID ? bids : offers);
+		int index = FindLevel(levels, node.priceTicks);
+		Unlink(levels[index], handle);
+		if (levels[index].head == OrderNodePool::NIL) levels.erase(levels.begin() + index);
+		pool.Release(handle);
+		return true;
+	}
+
+	// Get the best price and total quantity there on a side; false if the side is empty
+	bool GetTouch(PricingSide side, int32_t &priceTicks, long &quantity) const
+	{
+		const vector<PriceLevel> &levels = (side == BID ? bids : offers);
+		if (levels.empty()) return false;
+		priceTicks = levels.back().priceTicks;
+		quantity = levels.back().quantity;
+		return true;
+	}
+
+	// Get the number of price levels on a side
+	size_t GetDepth(PricingSide side) const
+	{
+		return (side == BID ? bids.size() : offers.size());
+	}
+
+	// Get the product
+	const T& GetProduct() const
+	{
+		return *product;
+	}
+
+private:
+	struct PriceLevel
+	{
+		int32_t priceTicks;
+		long quantity;
+		uint32_t head;
+		uint32_t tail;
+	};
+
+	const T *product;
+	Market venue;
+	const vector<FillListener<T>*> *listeners;
+	vector<PriceLevel> bids;      // ascending, best bid at the back
+	vector<PriceLevel> offers;    // descending, best offer at the back
+	OrderNodePool pool;
+
+	// Is a resting price on the opposite side acceptable to an order on side at limit?
+	static bool Crosses(PricingSide side, int32_t restingTicks, int32_t limitTicks)
+	{
+		return (side == BID ? restingTicks <= limitTicks : restingTicks >= limitTicks);
+	}
+
+	// Quantity available to an order on side up to limit
+	long Available(PricingSide side, int32_t limitTicks) const
+	{
+		const vector<PriceLevel> &levels = (side == BID ? offers : bids);
+		long available = 0;
+		for (int i = (int)levels.size() - 1; i >= 0 && Crosses(side, levels[i].priceTicks, limitTicks); i--)
+		{
+			available += levels[i].quantity;
+		}
+		return available;
+	}
+
+	// Trade an incoming order against the opposite side, adding quantity times price traded
+	// to notionalTicks; returns the quantity left
+	long Match(PricingSide side, bool anyPrice, int32_t limitTicks, long quantity, IdType orderId, int64_t &notionalTicks)
+	{
+		vector<PriceLevel> &levels = (side == BID ? offers : bids);
+		while (quantity > 0 && !levels.empty())
+		{
+			PriceLevel &level = levels.back();
+			if (!anyPrice && !Crosses(side, level.priceTicks, limitTicks)) break;
+			while (quantity > 0 && level.head != OrderNodePool::NIL)
+			{
+				uint32_t index = level.head;
+				OrderNode &resting = pool[index];
+				long traded = (quantity < resting.quantity ? quantity : resting.quantity);
+				quantity -= traded;
+				resting.quantity -= traded;
+				level.quantity -= traded;
+				notionalTicks += (int64_t)traded * level.priceTicks;
+				Report(orderId, resting.orderId, side, level.priceTicks, traded, quantity, true);
+				Report(resting.orderId, orderId, resting.side, level.priceTicks, traded, resting.quantity, false);
+				if (resting.quantity == 0)
+				{
+					Unlink(level, index);
+					pool.Release(index);
+				}
+			}
+			if (level.head == OrderNodePool::NIL) levels.pop_back();
+		}
+		return quantity;
+	}
+
+	// Queue the remainder of an order at its price level; returns its handle
+	uint32_t Rest(PricingSide side, int32_t priceTicks, long quantity, IdType orderId)
+	{
+		vector<PriceLevel> &levels = (side == BID ? bids : offers);
+		// levels improve towards the back; walk in from the touch to find the slot
+		int index = (int)levels.size();
+		while (index > 0 && Better(side, levels[index - 1].priceTicks, priceTicks)) index--;
+		if (index == 0 || levels[index - 1].priceTicks != priceTicks)
+		{
+			PriceLevel level;
+			level.priceTicks = priceTicks;
+			level.quantity = 0;
+			level.head = OrderNodePool::NIL;
+			level.tail = OrderNodePool::NIL;
+			levels.insert(levels.begin() + index, level);
+			index++;
+		}
+		PriceLevel &level = levels[index - 1];
+
+		uint32_t handle = pool.Acquire();
+		OrderNode &node = pool[handle];
+		node.orderId = orderId;
+		node.quantity = quantity;
+		node.priceTicks = priceTicks;
+		node.side = side;
+		node.live = true;
+		node.prev = level.tail;
+		node.next = OrderNodePool::NIL;
+		if (level.tail != OrderNodePool::NIL) pool[level.tail].next = handle;
+		else level.head = handle;
+		level.tail = handle;
+		level.quantity += quantity;
+		return handle;
+	}
+
+	// Is price a better level than other on side?
+	static bool Better(PricingSide side, int32_t price, int32_t other)
+	{
+		return (side == BID ? price > other : price < other);
+	}
+
+	// Find the index of the level holding priceTicks on side
+	int FindLevel(const vector<PriceLevel> &levels, int32_t priceTicks) const
+	{
+		int index = (int)levels.size() - 1;
+		while (levels[index].priceTicks != priceTicks) index--;
+		return index;
+	}
+
+	// Take a node out of its level's queue
+	void Unlink(PriceLevel &level, uint32_t index)
+	{
+		OrderNode &node = pool[index];
+		if (node.prev != OrderNodePool::NIL) pool[node.prev].next = node.next;
+		else level.head = node.next;
+		if (node.next != OrderNodePool::NIL) pool[node.next].prev = node.prev;
+		else level.tail = node.prev;
+		level.quantity -= node.quantity;
+	}
+
+	void Report(IdType orderId, IdType contraOrderId, PricingSide side, int32_t priceTicks, long quantity, long leaves, bool aggressor)
+	{
+		if (listeners->empty()) return;
+		ExchangeFill<T> fill;
+		fill.product = product;
+		fill.venue = venue;
+		fill.orderId = orderId;
+		fill.contraOrderId = contraOrderId;
+		fill.side = side;
+		fill.priceTicks = priceTicks;
+		fill.quantity = quantity;
+		fill.leavesQuantity = leaves;
+		fill.aggressor = aggressor;
+		for (int i = 0; i < listeners->size(); i++)
+		{
+			(*listeners)[i]->OnFill(fill);
+		}
+	}
+
+};
+
+/**
+* Exchange simulator holding one matching book per product and venue.
+* Execution orders are matched in the book of their product on the venue they are sent to,
+* under their own order id, which fills report back; liquidity seeded with LoadBook rests
+* under outside ids (IdGenerator::EXTERNAL_SESSION), so it never collides with ours.
+* Hidden quantity is not modelled: an order trades its visible quantity.
+* Single-threaded: orders and fill callbacks run on the caller's thread.
+* Type T is the product type.
+*/
+template<typename T>
+class ExchangeSimulator : public ExecutionVenue<T>
+{
+public:
+	static ExchangeSimulator<T>* Generate_Instance()
+	{
+		static ExchangeSimulator<T> instance;
+		return &instance;
+	}
+
+	// Register a fill callback
+	void AddListener(FillListener<T> *_listener) override
+	{
+		ListenerList.push_back(_listener);
+	}
+
+	// Unregister a fill callback
+	void RemoveListener(FillListener<T> *_listener) override
+	{
+		ListenerList.erase(remove(ListenerList.begin(), ListenerList.end(), _listener), ListenerList.end());
+	}
+
+	// Get the book of a product on a venue, creating it if needed; the book lives as long as
+	// the simulator, so senders on a hot path look it up once and keep it
+	MatchingBook<T>* GetBook(const T &_product, Market _market)
+	{
+		map<string, MatchingBook<T>*> &books = BookMap[_market];
+		auto it = books.find(_product.GetProductId());
+		if (it != books.end()) return it->second;
+		ProductList.push_back(new T(_product));
+		MatchingBook<T> *book = new MatchingBook<T>(ProductList.back(), _market, &ListenerList);
+		books.insert(pair<string, MatchingBook<T>*>(_product.GetProductId(), book));
+		return book;
+	}
+
+	// Send an execution order to a venue
+	SubmitResult Submit(const ExecutionOrder<T> &_order, Market _market)
+	{
+		MatchingBook<T> *book = GetBook(_order.GetProduct(), _market);
+		int32_t priceTicks = (int32_t)lround(_order.GetPrice() * TICKS_PER_POINT);
+		return book->Submit(_order.GetSide(), _order.GetOrderType(), priceTicks, _order.GetVisibleQuantity(), _order.GetOrderId());
+	}
+
+	// ExecutionVenue: execute an order from the ExecutionService
+	ExecutionReport Execute(const ExecutionOrder<T> &_order, Market _market) override
+	{
+		SubmitResult result = Submit(_order, _market);
+		ExecutionReport report;
+		report.filledQuantity = result.filledQuantity;
+		report.averagePrice = result.averagePriceTicks / TICKS_PER_POINT;
+		report.restingQuantity = (result.status == ORDER_RESTING ? _order.GetVisibleQuantity() - result.filledQuantity : 0);
+		return report;
+	}
+
+	// Rest every level of an order book on a venue as limit orders, e.g. to seed liquidity
+	void LoadBook(const OrderBook<T> &_orderbook, Market _market)
+	{
+		MatchingBook<T> *book = GetBook(_orderbook.GetProduct(), _market);
+		const vector<Order> &bidStack = _orderbook.GetBidStack();
+		const vector<Order> &offerStack = _orderbook.GetOfferStack();
+		for (int i = 0; i < bidStack.size(); i++)
+		{
+			book->Submit(BID, LIMIT, (int32_t)lround(bidStack[i].GetPrice() * TICKS_PER_POINT), bidStack[i].GetQuantity(), NextLiquidityId());
+		}
+		for (int i = 0; i < offerStack.size(); i++)
+		{
+			book->Submit(OFFER, LIMIT, (int32_t)lround(offerStack[i].GetPrice() * TICKS_PER_POINT), offerStack[i].GetQuantity(), NextLiquidityId());
+		}
+	}
+
+private:
+	vector<FillListener<T>*> ListenerList;
+	map<string, MatchingBook<T>*> BookMap[3];    // per Market
+	vector<T*> ProductList;
+	uint64_t liquiditySequence;
+
+	ExchangeSimulator()
+	{
+		liquiditySequence = 0;
+	}
+
+	// Get the outside id of the next order seeded by LoadBook
+	IdType NextLiquidityId()
+	{
+		return IdGenerator::Make(IdGenerator::EXTERNAL_SESSION, ++liquiditySequence);
+	}
+
+	~ExchangeSimulator()
+	{
+		for (int m = 0; m < 3; m++)
+		{
+			for (auto it = BookMap[m].begin(); it != BookMap[m].end(); ++it) delete it->second;
+		}
+		for (int i = 0; i < ProductList.size(); i++) delete ProductList[i];
+	}
+};
+
+#endif
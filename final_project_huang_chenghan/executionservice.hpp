@@ -12,6 +12,7 @@
 #include "soa.hpp"
 #include "marketdataservice.hpp"
 #include "tradebookingservice.hpp"
+#include "idgenerator.hpp"
  //#include "products.hpp"
 
 enum OrderType { FOK, IOC, MARKET, LIMIT, STOP };
@@ -31,13 +32,13 @@ public:
 	ExecutionOrder() {}
 
 	// ctor for an order
-	ExecutionOrder(const T &_product, PricingSide _side, string _orderId, OrderType _orderType, double _price, double _visibleQuantity, double _hiddenQuantity, string _parentOrderId, bool _isChildOrder);
+	ExecutionOrder(const T &_product, PricingSide _side, IdType _orderId, OrderType _orderType, double _price, double _visibleQuantity, double _hiddenQuantity, IdType _parentOrderId, bool _isChildOrder);
 
 	// Get the product
 	const T& GetProduct() const;
 
 	// Get the order ID
-	const string& GetOrderId() const;
+	IdType GetOrderId() const;
 
 	// Get the order type on this order
 	OrderType GetOrderType() const;
@@ -57,7 +58,7 @@ public:
 	long GetHiddenQuantity() const;
 
 	// Get the parent order ID
-	const string& GetParentOrderId() const;
+	IdType GetParentOrderId() const;
 
 	// Is child order?
 	bool IsChildOrder() const;
@@ -75,12 +76,15 @@ public:
 		}
 		os << "Product: " << t.GetProduct() << endl;
 		os << "  pricingSide: " << (t.side == BID ? "BID" : "OFFER") << endl;
-		os << "  orderID: " << t.GetOrderId() << endl;
+		char id[32];
+		IdGenerator::Render(t.GetOrderId(), id);
+		os << "  orderID: " << id << endl;
 		os << "  orderType: " << ot << endl;
 		os << "  price: " << t.GetPrice() << endl;
 		os << "  visibleQuantity: " << t.GetVisibleQuantity() << endl;
 		os << "  hiddenQuantity: " << t.GetHiddenQuantity() << endl;
-		os << "  parentOrderId: " << t.GetParentOrderId() << endl;
+		IdGenerator::Render(t.GetParentOrderId(), id);
+		os << "  parentOrderId: " << id << endl;
 		os << "  isChildOrder: " << std::boolalpha << t.IsChildOrder() << endl;
 		return os;
 	}
@@ -88,35 +92,128 @@ public:
 private:
 	T product;
 	PricingSide side;
-	string orderId;
+	IdType orderId;
 	OrderType orderType;
 	double price;
 	double visibleQuantity;
 	double hiddenQuantity;
-	string parentOrderId;
+	IdType parentOrderId;
 	bool isChildOrder;
 
 };
 
+/**
+* What a venue filled of an order when it was sent, and what of it rests there to fill later.
+*/
+struct ExecutionReport
+{
+	long filledQuantity;
+	double averagePrice;
+	long restingQuantity;
+};
+
+/**
+* One fill, reported once for the aggressor and once for the resting order it traded with.
+* Prices are in ticks of 1/256th; leavesQuantity is what is left of orderId after the fill.
+* Order ids are those of the ExecutionOrders sent, so a fill can be traced to its parent.
+* Type T is the product type.
+*/
+template<typename T>
+struct ExchangeFill
+{
+	const T* product;
+	Market venue;
+	IdType orderId;
+	IdType contraOrderId;
+	PricingSide side;
+	int32_t priceTicks;
+	long quantity;
+	long leavesQuantity;
+	bool aggressor;
+};
+
+/**
+* Callback for fills from the exchange.
+* Type T is the product type.
+*/
+template<typename T>
+class FillListener
+{
+
+public:
+
+	virtual ~FillListener() {}
+
+	// Called for every fill, on the thread that sent the order
+	virtual void OnFill(const ExchangeFill<T> &fill) = 0;
+
+};
+
+/**
+* Somewhere execution orders are sent to, e.g. the exchange simulator.
+* Type T is the product type.
+*/
+template<typename T>
+class ExecutionVenue
+{
+
+public:
+
+	virtual ~ExecutionVenue() {}
+
+	// Execute an order on a market, reporting what filled on arrival
+	virtual ExecutionReport Execute(const ExecutionOrder<T> &order, Market market) = 0;
+
+	// Register a callback for the venue's fills
+	virtual void AddListener(FillListener<T> *listener) = 0;
+
+	// Unregister a fill callback
+	virtual void RemoveListener(FillListener<T> *listener) = 0;
+
+};
+
 /**
 * Service for executing orders on an exchange.
+* Orders are sent to the venue when one is set, otherwise they fill in full at their price.
+* With trade booking enabled, every fill is booked as a Trade through a TradeBookingQueue,
+* round-robin across the books, so positions and risk follow our own executions; fills queue
+* for at most the queue's max age, checked on each fill and on FlushExpiredTrades.
+* What an order leaves resting on the venue is booked as the venue fills it later: the service
+* listens to the venue's fills and keeps the book of each resting order by its order id, so
+* every fill of one order goes to the same book.
 * Keyed on product identifier.
 * Type T is the product type.
 */
 template<typename T>
-class ExecutionService : public Service<string, ExecutionOrder <T> >
+class ExecutionService : public Service<string, ExecutionOrder <T> >, public FillListener<T>
 {
 
 public:
 	map<string, ExecutionOrder<T>> OrderMap;
 	vector<ServiceListener<ExecutionOrder<T>>*> ListenerList;
 	vector<string> booklist{ "TRSY1", "TRSY2", "TRSY3" };
-	int tradeID, bookID;
+	int bookID;
+	map<IdType, int> RestingOrderMap;    // book of each order resting on the venue, by order id
 
 	ExecutionService()
 	{
 		bookID = 0;
-		tradeID = 0;
+		venue = nullptr;
+		bookingQueue = nullptr;
+	}
+
+	~ExecutionService()
+	{
+		delete bookingQueue;
+	}
+
+	// Send orders on to _venue as well, booking its later fills on them (nullptr to stop)
+	void SetVenue(ExecutionVenue<T> *_venue)
+	{
+		if (venue != nullptr) venue->RemoveListener(this);
+		venue = _venue;
+		if (venue != nullptr) venue->AddListener(this);
+		RestingOrderMap.clear();
 	}
 
 	static ExecutionService<T>* Generate_Instance()
@@ -125,44 +222,92 @@ public:
 		return &instance;
 	}
 
-	// Execute an order on a market
-	void ExecuteOrder(const ExecutionOrder<T>& _order, Market _market)
+	// Book fills into _service in batches of _batchSize, none waiting more than _maxAgeUs (nullptr to stop)
+	void SetTradeBooking(TradeBookingService<T> *_service, size_t _batchSize, long _maxAgeUs)
+	{
+		if (bookingQueue != nullptr) bookingQueue->Flush();
+		delete bookingQueue;
+		bookingQueue = (_service != nullptr ? new TradeBookingQueue<T>(_service, _batchSize, _maxAgeUs) : nullptr);
+	}
+
+	// Book the queued fills if the oldest has waited too long; call on every tick
+	void FlushExpiredTrades()
+	{
+		if (bookingQueue != nullptr) bookingQueue->FlushExpired();
+	}
+
+	// Book the fills still queued
+	void FlushTrades()
 	{
-		T product = _order.GetProduct();
+		if (bookingQueue != nullptr) bookingQueue->Flush();
+	}
+
+	// Get the fill to position latency of booked fills
+	const LatencyStats& GetBookingLatency() const
+	{
+		static LatencyStats empty;
+		return (bookingQueue != nullptr ? bookingQueue->GetLatency() : empty);
+	}
+
+	// Execute an order on a market; returns the quantity filled
+	long ExecuteOrder(const ExecutionOrder<T>& _order, Market _market)
+	{
+		const T &product = _order.GetProduct();
 		double price = _order.GetPrice();
+		long quantity = _order.GetVisibleQuantity();
 		Side side = (_order.GetSide() == BID ? BUY : SELL);
 		ExecutionOrder<T> order = _order;
+		long resting = 0;
 
-		/*char[10] id_char;
-		sprintf(id_char, "%d", tradeID++);
-		std::string id = String.valueOf(id_char);*/
-
-		stringstream ss;
-		ss << tradeID;
-		tradeID++;
-		string id = ss.str();
+		if (venue != nullptr)
+		{
+			ExecutionReport report = venue->Execute(_order, _market);
+			quantity = report.filledQuantity;
+			price = report.averagePrice;
+			resting = report.restingQuantity;
+		}
 
-		Trade<T> trade(product, id, price, booklist[bookID], _order.GetVisibleQuantity(), side);
-		bookID = (bookID + 1) % 3;
+		int book = bookID;
+		if (quantity > 0 || resting > 0) bookID = (bookID + 1) % 3;
+		if (quantity > 0)
+		{
+			Trade<T> trade(product, IdGenerator::Trades().Next(), price, booklist[book], quantity, side);
+			if (bookingQueue != nullptr) bookingQueue->Push(std::move(trade));
+		}
+		if (resting > 0) RestingOrderMap[_order.GetOrderId()] = book;
 
 		for (int i = 0; i < ListenerList.size(); i++)
 		{
 			ServiceListener<ExecutionOrder<T>>* listener = ListenerList[i];
 			listener->ProcessAdd(order);
 		}
+		return (quantity > 0 ? quantity : 0);
+	}
+
+	// FillListener: book a venue fill on one of our resting orders through the booking queue;
+	// fills on arrival were booked by ExecuteOrder from the venue's report
+	void OnFill(const ExchangeFill<T> &_fill) override
+	{
+		if (_fill.aggressor) return;
+		auto it = RestingOrderMap.find(_fill.orderId);
+		if (it == RestingOrderMap.end()) return;
+		Trade<T> trade(*_fill.product, IdGenerator::Trades().Next(), (double)_fill.priceTicks / TICKS_PER_POINT,
+			booklist[it->second], _fill.quantity, (_fill.side == BID ? BUY : SELL));
+		if (_fill.leavesQuantity == 0) RestingOrderMap.erase(it);
+		if (bookingQueue != nullptr) bookingQueue->Push(std::move(trade));
 	}
 
 	void AddOrder(ExecutionOrder<T> &_order)
 	{
-		T BondProduct = _order.GetProduct();
-		OrderMap.insert(pair<string, ExecutionOrder<T>>(BondProduct.GetProductId(), _order));
+		const string &id = _order.GetProduct().GetProductId();
+		if (OrderMap.find(id) == OrderMap.end()) OrderMap.emplace(id, _order);
 	}
 
 	virtual void OnMessage(ExecutionOrder<T> &_order) {}
 
 	virtual ExecutionOrder<T>& GetData(string _id)
 	{
-		return OrderMap[_id];
+		return OrderMap.at(_id);
 	}
 
 	virtual void AddListener(ServiceListener<ExecutionOrder<T>>* _listener)
@@ -174,6 +319,10 @@ public:
 	{
 		return ListenerList;
 	}
+
+private:
+	ExecutionVenue<T> *venue;
+	TradeBookingQueue<T> *bookingQueue;
 };
 
 //template<typename T>
@@ -210,7 +359,7 @@ public:
 //};
 
 template<typename T>
-ExecutionOrder<T>::ExecutionOrder(const T &_product, PricingSide _side, string _orderId, OrderType _orderType, double _price, double _visibleQuantity, double _hiddenQuantity, string _parentOrderId, bool _isChildOrder) :
+ExecutionOrder<T>::ExecutionOrder(const T &_product, PricingSide _side, IdType _orderId, OrderType _orderType, double _price, double _visibleQuantity, double _hiddenQuantity, IdType _parentOrderId, bool _isChildOrder) :
 	product(_product)
 {
 	side = _side;
@@ -230,7 +379,7 @@ const T& ExecutionOrder<T>::GetProduct() const
 }
 
 template<typename T>
-const string& ExecutionOrder<T>::GetOrderId() const
+IdType ExecutionOrder<T>::GetOrderId() const
 {
 	return orderId;
 }
@@ -260,7 +409,7 @@ long ExecutionOrder<T>::GetHiddenQuantity() const
 }
 
 template<typename T>
-const string& ExecutionOrder<T>::GetParentOrderId() const
+IdType ExecutionOrder<T>::GetParentOrderId() const
 {
 	return parentOrderId;
 }
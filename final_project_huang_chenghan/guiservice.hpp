@@ -1,6 +1,6 @@
 /**
-* algostreamingservice.hpp
-* Construct algo price streams.
+* guiservice.hpp
+* Publish throttled snapshots of the latest prices to the GUI.
 *
 * @author Chenghan Huang
 */
@@ -10,64 +10,272 @@
 #include "soa.hpp"
 #include "pricingservice.hpp"
 #include "products.hpp"
-#include <windows.h>
 #include <iostream>
-#include <time.h>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_set>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
 
+/**
+* Connector writing the GUI snapshots to output/gui.txt, one line per product.
+* Type T is the product type.
+*/
 template<typename T>
-class GUIService : public Service<string, Price <T> >
+class GUIConnector : public Connector<Price<T>>
 {
 public:
-	map<string, Price<T>> PriceMap;
+	static GUIConnector<T>* Generate_Instance()
+	{
+		static GUIConnector<T> instance;
+		return &instance;
+	}
+
+	// Write one price of the current snapshot
+	void Publish(Price<T> &data)
+	{
+		if (!os.is_open()) os.open("output/gui.txt", ios_base::app);
+		os << "time: " << timestamp << "; CUSID: " << data.GetProduct().GetProductId()
+			<< "; mid price: " << std::to_string(data.GetMid())
+			<< "; bid/offer spread: " << std::to_string(data.GetBidOfferSpread()) << "\n";
+	}
+
+	// Stamp the prices published from now on with the current time
+	void BeginSnapshot()
+	{
+		auto now = std::chrono::system_clock::now();
+		time_t seconds = std::chrono::system_clock::to_time_t(now);
+		long millis = (long)(std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count() % 1000);
+		struct tm local;
+		localtime_r(&seconds, &local);
+		char text[32];
+		size_t length = strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", &local);
+		snprintf(text + length, sizeof(text) - length, ".%03ld", millis);
+		timestamp = text;
+	}
+
+	// Finish the current snapshot
+	void EndSnapshot()
+	{
+		if (os.is_open()) os.flush();
+	}
+
+	void Subscribe() {}  // implement nothing, publish-only
+
+private:
+	ofstream os;
+	string timestamp;
+
+	GUIConnector() {}
+};
+
+/**
+* GUI service publishing a snapshot of the latest price of every product every throttleMs.
+* A timer thread wakes on the interval, copies the prices out of the PricingService seqlock
+* slots and publishes the ones that changed since its last snapshot, so the GUI gets at most
+* one update per product per interval whatever the tick rate, and the pricing thread never
+* waits on the GUI. GUIServiceListener adds each product the first time it is priced.
+* Type T is the product type.
+*/
+template<typename T>
+class GUIService : public Service<string, Price<T>>
+{
+public:
+	map<string, Price<T>> PriceMap;     // the last snapshot, written by the timer thread
 	vector<ServiceListener<Price<T>>*> ListenerList;
 
-	GUIService()
+	static GUIService<T>* Generate_Instance()
+	{
+		static GUIService<T> instance;
+		return &instance;
+	}
+
+	// Set the interval between snapshots; takes effect on the next Start
+	void SetThrottle(int _throttleMs)
 	{
+		throttleMs = _throttleMs;
+	}
 
+	// Add a product to the snapshots once it has been priced
+	void AddProduct(const string &id)
+	{
+		const SeqLock<Price<T>> *slot = PricingService<T>::Generate_Instance()->GetSlot(id);
+		if (slot == nullptr) return;
+		GUIProduct product;
+		product.slot = slot;
+		product.version = 0;
+		lock_guard<mutex> lock(productMutex);
+		ProductList.push_back(product);
 	}
 
-	void AddPrice(Price<T> &_data)
+	// Start the timer thread
+	void Start()
 	{
-		T BondProduct = _data.GetProduct();
-		PriceMap.insert(pair<string, Price<T>>(BondProduct.GetProductId(), _data);
+		lock_guard<mutex> lock(timerMutex);
+		if (running) return;
+		running = true;
+		timer = thread(&GUIService<T>::Run, this);
+	}
 
-		for (int i = 0; i < ListenerList.size(); i++)
+	// Stop the timer thread and publish a last snapshot of the prices it has not shown
+	void Stop()
+	{
 		{
-			ServiceListener<Price<T>>* listener = ListenerList[i];
-			listener->ProcessAdd(_data);
+			lock_guard<mutex> lock(timerMutex);
+			if (!running) return;
+			running = false;
 		}
+		wakeup.notify_all();
+		timer.join();
+		Snapshot();
+	}
+
+	// Get the number of snapshots taken
+	long GetSnapshotCount() const
+	{
+		return snapshotCount;
+	}
+
+	// Get the number of prices published over all snapshots
+	long GetPublishedCount() const
+	{
+		return publishedCount;
 	}
 
+	// Get a product's price in the last snapshot; read it once the service is stopped
 	virtual Price<T>& GetData(string _id)
 	{
-		return PriceMap[_id];
+		return PriceMap.at(_id);
 	}
 
+	virtual void OnMessage(Price<T> &data) {}
+
 	virtual void AddListener(ServiceListener<Price<T>>* _listener)
 	{
 		ListenerList.push_back(_listener);
 	}
 
-	virtual const vector< ServiceListener<Price<T>>* >& GetListeners()
+	virtual const vector< ServiceListener<Price<T>>* >& GetListeners() const
 	{
 		return ListenerList;
 	}
 
+	~GUIService()
+	{
+		Stop();
+	}
+
 private:
-	int maxvol_vis = 1000000;
-	int maxvol_hid = 10000000;
+	struct GUIProduct
+	{
+		const SeqLock<Price<T>> *slot;
+		uint64_t version;               // version of the last price published
+	};
+
+	GUIConnector<T>* _guiConnector;
+	int throttleMs;
+	long snapshotCount;
+	long publishedCount;
+
+	vector<GUIProduct> ProductList;     // appended by the pricing thread under productMutex
+	vector<GUIProduct> SnapshotList;    // the timer thread's copy
+	mutex productMutex;
+
+	thread timer;
+	bool running;
+	mutex timerMutex;
+	condition_variable wakeup;
+
+	GUIService()
+	{
+		_guiConnector = GUIConnector<T>::Generate_Instance();
+		throttleMs = 300;
+		snapshotCount = 0;
+		publishedCount = 0;
+		running = false;
+	}
+
+	void Run()
+	{
+		auto next = std::chrono::steady_clock::now() + std::chrono::milliseconds(throttleMs);
+		unique_lock<mutex> lock(timerMutex);
+		while (running)
+		{
+			if (wakeup.wait_until(lock, next, [this] { return !running; })) break;
+			lock.unlock();
+			Snapshot();
+			lock.lock();
+			next += std::chrono::milliseconds(throttleMs);
+		}
+	}
+
+	// Publish the prices that changed since the last snapshot
+	void Snapshot()
+	{
+		{
+			lock_guard<mutex> lock(productMutex);
+			for (size_t i = SnapshotList.size(); i < ProductList.size(); i++) SnapshotList.push_back(ProductList[i]);
+		}
+
+		_guiConnector->BeginSnapshot();
+		for (size_t i = 0; i < SnapshotList.size(); i++)
+		{
+			Price<T> price;
+			uint64_t version = SnapshotList[i].slot->Load(price);
+			if (version == SnapshotList[i].version) continue;
+			SnapshotList[i].version = version;
+			PriceMap[price.GetProduct().GetProductId()] = price;
+			_guiConnector->Publish(price);
+			for (auto& listener : ListenerList) listener->ProcessAdd(price);
+			publishedCount++;
+		}
+		_guiConnector->EndSnapshot();
+		snapshotCount++;
+	}
 };
 
+/**
+* Listener on the PricingService adding every newly priced product to the GUIService.
+* Type T is the product type.
+*/
 template<typename T>
-class GUIServiceListener : public ServiceListener<AlgoPriceStream<T>>
+class GUIServiceListener : public ServiceListener<Price<T>>
 {
 public:
-	virtual void ProcessAdd(Price<T> _data)
+	static GUIServiceListener<T>* Generate_Instance()
 	{
+		static GUIServiceListener<T> instance;
+		return &instance;
+	}
 
+	virtual void ProcessAdd(Price<T> &data)
+	{
+		const string &id = data.GetProduct().GetProductId();
+		if (KnownProducts.find(id) != KnownProducts.end()) return;
+		KnownProducts.insert(id);
+		guiservice->AddProduct(id);
+	}
 
+	virtual void ProcessRemove(Price<T> &data) {}
+	virtual void ProcessUpdate(Price<T> &data) {}
+
+	GUIService<T>* GetService()
+	{
+		return guiservice;
 	}
+
 private:
-	PricingService* pricingservice;
+	GUIService<T>* guiservice;
+	unordered_set<string> KnownProducts;    // pricing thread only
+
+	GUIServiceListener()
+	{
+		guiservice = GUIService<T>::Generate_Instance();
+	}
 };
-#endif
\ No newline at end of file
+#endif
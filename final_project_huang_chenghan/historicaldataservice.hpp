@@ -48,14 +48,15 @@ public:
 
 	void Publish(PV01<Bond>& data)
 	{
-		ofstream os("output/risk.txt", ios_base::app);
-		string msg = "PV01 is " + std::to_string(data.GetPV01());
-		os << msg << endl;
+		if (!os.is_open()) os.open("output/risk.txt", ios_base::app);
+		os << "PV01 is " << std::to_string(data.GetPV01()) << endl;
 	}
 
 	void Subscribe() {}
 
 private:
+	ofstream os;    // opened on the first record and kept open
+
 	BondHistoricalPV01Connector() {}
 
 };
@@ -119,15 +120,15 @@ public:
 	// function overloading
 	void Publish(ExecutionOrder<Bond>& data)
 	{
-		ofstream os("output/executions.txt", ios_base::app);
-		std::string msg = "executing order. orderid:" + data.GetOrderId()
-			+ " CUSID: " + data.GetProduct().GetProductId();
+		if (!os.is_open()) os.open("output/executions.txt", ios_base::app);
 		os << data << endl;
 	}
 
 	void Subscribe() {}  // implement nothing, publish-only
 
 private:
+	ofstream os;    // opened on the first record and kept open
+
 	BondHistoricalExecutionConnector() {}
 
 };
@@ -191,19 +192,19 @@ public:
 	// function overloading
 	void Publish(PriceStream<Bond>& data)
 	{
-		ofstream os("output/streaming.txt", ios_base::app);
+		if (!os.is_open()) os.open("output/streaming.txt", ios_base::app);
 
 		double bid = data.GetBidOrder().GetPrice();
 		double offer = data.GetOfferOrder().GetPrice();
-		std::string cus_id = data.GetProduct().GetProductId();
-		std::string msg = "CUSID: " + cus_id + "; bid price: " + std::to_string(bid) +
-			"; offer price: " + std::to_string(offer);
-		os << msg << endl;
+		os << "CUSID: " << data.GetProduct().GetProductId() << "; bid price: " << std::to_string(bid)
+			<< "; offer price: " << std::to_string(offer) << endl;
 	}
 
 	void Subscribe() {}  // implement nothing, publish-only
 
 private:
+	ofstream os;    // opened on the first record and kept open
+
 	BondHistoricalStreamingConnector() {}
 
 };
@@ -290,19 +291,20 @@ public:
 	// function overloading
 	void Publish(Inquiry<Bond>& data)
 	{
-		ofstream os("output/allinquiries.txt", ios_base::app);
-		std::string msg;
-		msg += "inquiry id is: " + data.GetInquiryId();
-		data.GetSide() == Side::BUY ? msg += "; BUY " : msg += "; SELL ";
-		msg += data.GetProduct().GetProductId() + " for ";
-		msg += std::to_string(data.GetQuantity()) + " quantity, at ";
-		msg += std::to_string(data.GetPrice()) + " price.";
-		os << msg << endl;
+		if (!os.is_open()) os.open("output/allinquiries.txt", ios_base::app);
+		char id[32];
+		IdGenerator::Render(data.GetInquiryId(), id);
+		os << "inquiry id is: " << id << (data.GetSide() == Side::BUY ? "; BUY " : "; SELL ")
+			<< data.GetProduct().GetProductId() << " for " << std::to_string(data.GetQuantity()) << " quantity, at "
+			<< std::to_string(data.GetPrice()) << " price, "
+			<< (data.GetState() == DONE ? "DONE." : data.GetState() == REJECTED ? "REJECTED." : "CUSTOMER_REJECTED.") << endl;
 	}
 
 	void Subscribe() {}  // implement nothing, publish-only
 
 private:
+	ofstream os;    // opened on the first record and kept open
+
 	BondHistoricalInquiryConnector() {}
 
 };
@@ -323,7 +325,7 @@ public:
 	}
 	void OnMessage(Inquiry<Bond> &b)
 	{
-		auto persistKey = b.GetProduct().GetProductId();
+		auto persistKey = IdGenerator::ToString(b.GetInquiryId());
 		_inquriyData[persistKey] = b;
 		std::cout << "flow the data from BondHistoricalInquiryService to the listener." << std::endl;
 		for (auto& lp : _listeners) lp->ProcessAdd(b); // notify listeners
@@ -363,7 +365,7 @@ public:
 	void ProcessAdd(Inquiry<Bond> &data)
 	{
 		_bondHistoryInquiryService->OnMessage(data);
-		_bondHistoryInquiryService->PersistData(data.GetProduct().GetProductId(), data); // to write.
+		_bondHistoryInquiryService->PersistData(IdGenerator::ToString(data.GetInquiryId()), data); // to write.
 	}
 	void ProcessRemove(Inquiry<Bond> &data) {}
 	void ProcessUpdate(Inquiry<Bond> &data) {}
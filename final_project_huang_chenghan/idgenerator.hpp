@@ -0,0 +1,189 @@
+/**
+* idgenerator.hpp
+* Compact 64-bit identifiers for orders, trades and inquiries, rendered as strings only when persisted.
+*
+* @author Chenghan Huang
+*/
+#ifndef ID_GENERATOR_HPP
+#define ID_GENERATOR_HPP
+
+#include <string>
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <stdexcept>
+
+using namespace std;
+
+// Order, trade and inquiry identifier: 16-bit session in the top bits, 48-bit sequence below
+typedef uint64_t IdType;
+
+/**
+* Generator of identifiers unique across threads (the sequence is an atomic counter) and
+* across processes (every process, or shard within one, runs its own session).
+* The session is fixed at construction; the process-wide generators take the one given to
+* StartProcessSession, which must be called before the first of them is used. Next throws
+* once the 48-bit sequence is exhausted rather than carry into the session bits.
+* Session 0 renders as the plain sequence number, other sessions as session:sequence.
+* Sequences start at 1, so 0 is never issued: it is INVALID_ID, e.g. the parent of an order
+* that has none.
+*/
+class IdGenerator
+{
+
+public:
+
+	static const int SEQUENCE_BITS = 48;
+	static const uint64_t MAX_SEQUENCE = (1ULL << SEQUENCE_BITS) - 1;
+	static const uint16_t EXTERNAL_SESSION = 0xffff;    // ids received from outside, e.g. input files
+	static const IdType INVALID_ID = 0;                 // no identifier
+
+	// ctor for a generator in _session; identifiers start from sequence 1
+	explicit IdGenerator(uint16_t _session)
+	{
+		if (_session == EXTERNAL_SESSION) throw invalid_argument("IdGenerator session is reserved for outside ids");
+		prefix = (IdType)_session << SEQUENCE_BITS;
+		sequence.store(1, memory_order_relaxed);
+	}
+
+	// Set the session of the process-wide generators; once per process, before any of them is used
+	static void StartProcessSession(uint16_t _session)
+	{
+		if (_session == EXTERNAL_SESSION) throw invalid_argument("IdGenerator session is reserved for outside ids");
+		int unset = -1;
+		if (!ProcessSession().compare_exchange_strong(unset, _session)) throw logic_error("IdGenerator process session already started");
+	}
+
+	// The process-wide generator for order ids
+	static IdGenerator& Orders()
+	{
+		static IdGenerator instance(GetProcessSession());
+		return instance;
+	}
+
+	// The process-wide generator for trade ids
+	static IdGenerator& Trades()
+	{
+		static IdGenerator instance(GetProcessSession());
+		return instance;
+	}
+
+	// The process-wide generator for inquiry ids
+	static IdGenerator& Inquiries()
+	{
+		static IdGenerator instance(GetProcessSession());
+		return instance;
+	}
+
+	// Get the next identifier (any thread); throws overflow_error once the session's sequence is used up
+	IdType Next()
+	{
+		uint64_t next = sequence.fetch_add(1, memory_order_relaxed);
+		if (next > MAX_SEQUENCE) throw overflow_error("IdGenerator sequence exhausted in session " + to_string(GetSession(prefix)));
+		return prefix | next;
+	}
+
+	// Make the identifier of sequence number _sequence in _session
+	static IdType Make(uint16_t _session, uint64_t _sequence)
+	{
+		return ((IdType)_session << SEQUENCE_BITS) | (_sequence & MAX_SEQUENCE);
+	}
+
+	// Get the session of an identifier
+	static uint16_t GetSession(IdType id)
+	{
+		return (uint16_t)(id >> SEQUENCE_BITS);
+	}
+
+	// Get the sequence number of an identifier
+	static uint64_t GetSequence(IdType id)
+	{
+		return id & MAX_SEQUENCE;
+	}
+
+	// Render an identifier into buffer (at least 32 chars); returns the length
+	static int Render(IdType id, char *buffer)
+	{
+		char digits[24];
+		int length = 0;
+		uint16_t session = GetSession(id);
+		if (session != 0)
+		{
+			length = Digits(session, digits);
+			for (int i = 0; i < length; i++) buffer[i] = digits[length - 1 - i];
+			buffer[length++] = ':';
+		}
+		int count = Digits(GetSequence(id), digits);
+		for (int i = 0; i < count; i++) buffer[length++] = digits[count - 1 - i];
+		buffer[length] = '\0';
+		return length;
+	}
+
+	// Render an identifier as a string
+	static string ToString(IdType id)
+	{
+		char buffer[32];
+		int length = Render(id, buffer);
+		return string(buffer, length);
+	}
+
+	// Parse a rendered identifier, or the digits of an outside one such as "T12" (into
+	// EXTERNAL_SESSION); INVALID_ID if there are no digits
+	static IdType Parse(const string &text)
+	{
+		size_t colon = text.find(':');
+		if (colon != string::npos)
+		{
+			return Make((uint16_t)ParseDigits(text.substr(0, colon)), ParseDigits(text.substr(colon + 1)));
+		}
+		bool numeric = !text.empty() && text.find_first_not_of("0123456789") == string::npos;
+		if (text.find_first_of("0123456789") == string::npos) return INVALID_ID;
+		return (numeric ? ParseDigits(text) : Make(EXTERNAL_SESSION, ParseDigits(text)));
+	}
+
+private:
+	IdType prefix;
+	atomic<uint64_t> sequence;
+
+	// Session of the process-wide generators, -1 until started
+	static atomic<int>& ProcessSession()
+	{
+		static atomic<int> session(-1);
+		return session;
+	}
+
+	static uint16_t GetProcessSession()
+	{
+		int session = ProcessSession().load();
+		if (session < 0) throw logic_error("IdGenerator::StartProcessSession must be called before the first identifier");
+		return (uint16_t)session;
+	}
+
+	// Write the decimal digits of value, least significant first; returns how many
+	static int Digits(uint64_t value, char *digits)
+	{
+		int count = 0;
+		do
+		{
+			digits[count++] = (char)('0' + value % 10);
+			value /= 10;
+		} while (value > 0);
+		return count;
+	}
+
+	static uint64_t ParseDigits(const string &text)
+	{
+		uint64_t value = 0;
+		for (size_t i = 0; i < text.size(); i++)
+		{
+			if (text[i] >= '0' && text[i] <= '9') value = value * 10 + (text[i] - '0');
+		}
+		return value;
+	}
+
+	IdGenerator(const IdGenerator&);
+	IdGenerator& operator=(const IdGenerator&);
+
+};
+
+#endif
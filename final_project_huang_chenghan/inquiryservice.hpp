@@ -9,9 +9,15 @@
 
 #include "soa.hpp"
 #include "tradebookingservice.hpp"
+#include "pricingservice.hpp"
 #include "products.hpp"
+#include "idgenerator.hpp"
 #include <vector>
 #include <map>
+#include <memory>
+#include <cstdint>
+#include <stdexcept>
+#include <unordered_map>
 
 using namespace std;
 
@@ -34,10 +40,13 @@ public:
 	Inquiry() = default;
 
   // ctor for an inquiry
-  Inquiry(string _inquiryId, const T &_product, Side _side, long _quantity, double _price, InquiryState _state);
+  Inquiry(IdType _inquiryId, const T &_product, Side _side, long _quantity, double _price, InquiryState _state, const string &_client = "");
 
   // Get the inquiry ID
-  const string& GetInquiryId() const;
+  IdType GetInquiryId() const;
+
+  // Get the client inquiring
+  const string& GetClient() const;
 
   // Get the product
   const T& GetProduct() const;
@@ -63,7 +72,8 @@ public:
   void SetState(InquiryState _state);
 
 private:
-  string inquiryId;
+  IdType inquiryId;
+  string client;
   T product;
   Side side;
   long quantity;
@@ -147,6 +157,194 @@ private:
 };
  */
 
+/**
+* Store of the inquiries in flight, keyed on inquiry id.
+* Inquiries live in a slab of fixed-size chunks: a slot freed by Erase is the next one handed
+* out, so the store stays dense and a handle (slot number) and the inquiry it refers to stay
+* valid until erased. Open inquiries (RECEIVED or QUOTED) are indexed by product and by client,
+* and every inquiry by state; each index is an unordered list of handles that a slot knows its
+* position in, so updating an index is O(1) and GetOpenByProduct is O(1) plus the caller's
+* O(open inquiries on that product) walk.
+* Type T is the product type.
+*/
+template<typename T>
+class InquiryStore
+{
+
+public:
+	typedef uint32_t Handle;
+	static const Handle NIL = 0xffffffff;
+
+	InquiryStore() : freeHead(NIL), count(0) {}
+
+	// Add an inquiry; NIL if its id is already stored
+	Handle Insert(const Inquiry<T> &inquiry)
+	{
+		if (IdMap.find(inquiry.GetInquiryId()) != IdMap.end()) return NIL;
+		Handle handle = Allocate();
+		Slot &slot = At(handle);
+		slot.inquiry = inquiry;
+		IdMap[inquiry.GetInquiryId()] = handle;
+		Link(handle, slot);
+		count++;
+		return handle;
+	}
+
+	// Get the handle of an inquiry id; NIL if not stored
+	Handle Find(IdType id) const
+	{
+		auto it = IdMap.find(id);
+		return (it == IdMap.end() ? NIL : it->second);
+	}
+
+	// Get the inquiry of a handle
+	Inquiry<T>& Get(Handle handle)
+	{
+		return At(handle).inquiry;
+	}
+
+	// Move an inquiry to a new state (and price), keeping the indices up to date
+	void Set(Handle handle, double price, InquiryState state)
+	{
+		Slot &slot = At(handle);
+		Unlink(handle, slot);
+		slot.inquiry.Set(price, state);
+		Link(handle, slot);
+	}
+
+	// Remove an inquiry; its slot is reused by the next Insert
+	void Erase(Handle handle)
+	{
+		Slot &slot = At(handle);
+		Unlink(handle, slot);
+		IdMap.erase(slot.inquiry.GetInquiryId());
+		slot.nextFree = freeHead;
+		freeHead = handle;
+		count--;
+	}
+
+	// Get the open inquiries on a product
+	const vector<Handle>& GetOpenByProduct(const string &productId) const
+	{
+		auto it = ProductIndex.find(productId);
+		return (it == ProductIndex.end() ? empty : it->second);
+	}
+
+	// Get the open inquiries of a client
+	const vector<Handle>& GetOpenByClient(const string &client) const
+	{
+		auto it = ClientIndex.find(client);
+		return (it == ClientIndex.end() ? empty : it->second);
+	}
+
+	// Get the inquiries in a state
+	const vector<Handle>& GetByState(InquiryState state) const
+	{
+		return StateIndex[state];
+	}
+
+	// Get the number of inquiries stored
+	size_t GetSize() const
+	{
+		return count;
+	}
+
+private:
+	static const int CHUNK_BITS = 8;
+	static const Handle CHUNK_SIZE = 1 << CHUNK_BITS;
+
+	struct Slot
+	{
+		Inquiry<T> inquiry;
+		uint32_t productPos;
+		uint32_t clientPos;
+		uint32_t statePos;
+		Handle nextFree;
+	};
+
+	vector<unique_ptr<Slot[]>> chunks;
+	Handle freeHead;
+	size_t count;
+	unordered_map<IdType, Handle> IdMap;
+	unordered_map<string, vector<Handle>> ProductIndex;
+	unordered_map<string, vector<Handle>> ClientIndex;
+	vector<Handle> StateIndex[CUSTOMER_REJECTED + 1];
+	vector<Handle> empty;
+
+	Slot& At(Handle handle)
+	{
+		return chunks[handle >> CHUNK_BITS][handle & (CHUNK_SIZE - 1)];
+	}
+
+	Handle Allocate()
+	{
+		if (freeHead == NIL)
+		{
+			// thread a new chunk onto the free list, lowest slot first
+			Handle base = (Handle)chunks.size() << CHUNK_BITS;
+			chunks.push_back(unique_ptr<Slot[]>(new Slot[CHUNK_SIZE]));
+			for (Handle i = CHUNK_SIZE; i > 0; i--)
+			{
+				chunks.back()[i - 1].nextFree = freeHead;
+				freeHead = base + i - 1;
+			}
+		}
+		Handle handle = freeHead;
+		freeHead = At(handle).nextFree;
+		return handle;
+	}
+
+	static bool IsOpen(InquiryState state)
+	{
+		return state == RECEIVED || state == QUOTED;
+	}
+
+	void Link(Handle handle, Slot &slot)
+	{
+		InquiryState state = slot.inquiry.GetState();
+		slot.statePos = Push(StateIndex[state], handle);
+		if (!IsOpen(state)) return;
+		slot.productPos = Push(ProductIndex[slot.inquiry.GetProduct().GetProductId()], handle);
+		slot.clientPos = Push(ClientIndex[slot.inquiry.GetClient()], handle);
+	}
+
+	void Unlink(Handle handle, Slot &slot)
+	{
+		InquiryState state = slot.inquiry.GetState();
+		Remove(StateIndex[state], slot.statePos, &Slot::statePos);
+		if (!IsOpen(state)) return;
+		Remove(ProductIndex[slot.inquiry.GetProduct().GetProductId()], slot.productPos, &Slot::productPos);
+		Remove(ClientIndex[slot.inquiry.GetClient()], slot.clientPos, &Slot::clientPos);
+	}
+
+	static uint32_t Push(vector<Handle> &list, Handle handle)
+	{
+		list.push_back(handle);
+		return (uint32_t)(list.size() - 1);
+	}
+
+	// Swap-remove the entry at pos, telling the handle moved into it its new position
+	void Remove(vector<Handle> &list, uint32_t pos, uint32_t Slot::*position)
+	{
+		Handle last = list.back();
+		list[pos] = last;
+		At(last).*position = pos;
+		list.pop_back();
+	}
+
+};
+
+/**
+* Inquiry service running each RFQ through RECEIVED -> QUOTED -> DONE / CUSTOMER_REJECTED,
+* or RECEIVED -> REJECTED when it cannot be quoted. Inquiries are keyed on their unique id.
+* A new inquiry is quoted at once from the latest PricingService mid: clients buying get
+* the offer, clients selling the bid, at half the bid/offer spread plus spreadTicksPerMillion
+* ticks per million of quantity, capped at maxSpreadTicks. The quote goes to the client
+* through the connector, and the client's reply, which comes later, completes the inquiry;
+* listeners are told about every inquiry that reaches a final state, after which it leaves the store.
+* When a product is repriced, Requote reprices every inquiry still QUOTED on it in one pass
+* and sends the client only the quotes that moved by a tick or more.
+*/
 template<typename T>
 class InquiryService : public Service<string,Inquiry <Bond> >
 {
@@ -157,21 +355,145 @@ public:
 		return &instance;
 	}
 
+	// Set the quoting parameters: spread added per million of quantity, spread cap, largest size quoted
+	void SetQuoting(double _spreadTicksPerMillion, double _maxSpreadTicks, long _maxQuantity)
+	{
+		spreadTicksPerMillion = _spreadTicksPerMillion;
+		maxSpreadTicks = _maxSpreadTicks;
+		maxQuantity = _maxQuantity;
+	}
+
+	// Price a quote for an inquiry from the latest mid; false if it cannot be quoted
+	bool PriceQuote(const Inquiry<Bond> &inquiry, double &quote)
+	{
+		if (inquiry.GetQuantity() <= 0 || inquiry.GetQuantity() > maxQuantity) return false;
+		const SeqLock<Price<Bond>> *slot = GetPriceSlot(inquiry.GetProduct().GetProductId());
+		Price<Bond> price;
+		if (slot == nullptr || slot->Load(price) == 0) return false;
+		double spreadTicks = price.GetBidOfferSpreadTicks() / 2.0 + inquiry.GetQuantity() / 1000000.0 * spreadTicksPerMillion;
+		if (spreadTicks > maxSpreadTicks) spreadTicks = maxSpreadTicks;
+		double mid = (double)price.GetMidTicks() / TICKS_PER_POINT;
+		quote = (inquiry.GetSide() == BUY ? mid + spreadTicks / TICKS_PER_POINT : mid - spreadTicks / TICKS_PER_POINT);
+		return true;
+	}
+
 	// Send a quote back to the client
-	void SendQuote(const string &inquiryId, double price) {}
+	void SendQuote(IdType inquiryId, double price)
+	{
+		InquiryStore<Bond>::Handle handle = _inquiryStore.Find(inquiryId);
+		if (handle == InquiryStore<Bond>::NIL || _inquiryStore.Get(handle).GetState() != RECEIVED) return;
+		_inquiryStore.Set(handle, price, QUOTED);
+		Inquiry<Bond> quoted = _inquiryStore.Get(handle);
+		// looked up here: the connector's ctor needs this service
+		InquiryConnector<T>::Generate_Instance()->Publish(quoted);
+	}
 
 	// Reject an inquiry from the client
-	void RejectInquiry(const string &inquiryId) {}
+	void RejectInquiry(IdType inquiryId)
+	{
+		InquiryStore<Bond>::Handle handle = _inquiryStore.Find(inquiryId);
+		if (handle == InquiryStore<Bond>::NIL) return;
+		_inquiryStore.Set(handle, _inquiryStore.Get(handle).GetPrice(), REJECTED);
+		Finish(handle);
+	}
 
-	void OnMessage(Inquiry<Bond> &trade) override {
-		trade.Set(trade.GetPrice(), DONE);
+	// A new inquiry (RECEIVED) or the client's answer to our quote (DONE or CUSTOMER_REJECTED);
+	// anything out of turn for its inquiry is ignored
+	void OnMessage(Inquiry<Bond> &inquiry) override {
+		IdType id = inquiry.GetInquiryId();
+		if (inquiry.GetState() == RECEIVED)
+		{
+			if (_inquiryStore.Insert(inquiry) == InquiryStore<Bond>::NIL) return;
+			double quote;
+			if (PriceQuote(inquiry, quote)) SendQuote(id, quote);
+			else RejectInquiry(id);
+			return;
+		}
+
+		InquiryStore<Bond>::Handle handle = _inquiryStore.Find(id);
+		if (handle == InquiryStore<Bond>::NIL || _inquiryStore.Get(handle).GetState() != QUOTED) return;
+		if (inquiry.GetState() != DONE && inquiry.GetState() != CUSTOMER_REJECTED) return;
+		_inquiryStore.Set(handle, _inquiryStore.Get(handle).GetPrice(), inquiry.GetState());
+		Finish(handle);
+	}
+
+	void PushToListeners(Inquiry<Bond> &inquiry)
+	{
 		std::cout << "flow the data from inquiryservice to the listener." << std::endl;
 		for (auto& listener : _listeners)
-			listener->ProcessAdd(trade);
+			listener->ProcessAdd(inquiry);
 	}
 
-	Inquiry<Bond>& GetData(std::string _cusip) override {
-		return _inquiryData.at(_cusip);
+	// Get an open inquiry by its rendered id; finished inquiries are with the listeners
+	Inquiry<Bond>& GetData(std::string _id) override {
+		InquiryStore<Bond>::Handle handle = _inquiryStore.Find(IdGenerator::Parse(_id));
+		if (handle == InquiryStore<Bond>::NIL) throw out_of_range("no open inquiry " + _id);
+		return _inquiryStore.Get(handle);
+	}
+
+	// Re-quote the QUOTED inquiries on a product from its new price
+	void Requote(const Price<Bond> &price)
+	{
+		const vector<InquiryStore<Bond>::Handle> &open = _inquiryStore.GetOpenByProduct(price.GetProduct().GetProductId());
+		if (open.empty()) return;
+
+		// gather the quoted inquiries into flat arrays
+		RequoteHandles.clear();
+		RequoteQuantity.clear();
+		RequoteSign.clear();
+		RequoteTicks.clear();
+		for (size_t i = 0; i < open.size(); i++)
+		{
+			Inquiry<Bond> &inquiry = _inquiryStore.Get(open[i]);
+			if (inquiry.GetState() != QUOTED) continue;
+			RequoteHandles.push_back(open[i]);
+			RequoteQuantity.push_back((double)inquiry.GetQuantity());
+			RequoteSign.push_back(inquiry.GetSide() == BUY ? 1.0 : -1.0);
+			RequoteTicks.push_back(inquiry.GetPrice() * TICKS_PER_POINT);
+		}
+		size_t count = RequoteHandles.size();
+		RequoteChange.resize(count);
+
+		// reprice them all as PriceQuote does, in one branch-free loop over doubles that vectorizes
+		double mid = (double)price.GetMidTicks();
+		double halfSpread = price.GetBidOfferSpreadTicks() / 2.0;
+		double perUnit = spreadTicksPerMillion / 1000000.0;
+		double cap = maxSpreadTicks;
+		const double *quantity = RequoteQuantity.data();
+		const double *sign = RequoteSign.data();
+		double *ticks = RequoteTicks.data();
+		double *change = RequoteChange.data();
+		for (size_t i = 0; i < count; i++)
+		{
+			double spread = halfSpread + quantity[i] * perUnit;
+			spread = (spread < cap ? spread : cap);
+			double quote = mid + sign[i] * spread;
+			change[i] = quote - ticks[i];
+			ticks[i] = quote;
+		}
+
+		// send the quotes that moved a tick
+		for (size_t i = 0; i < count; i++)
+		{
+			if (change[i] < 1.0 && change[i] > -1.0) continue;
+			InquiryStore<Bond>::Handle handle = RequoteHandles[i];
+			_inquiryStore.Set(handle, ticks[i] / TICKS_PER_POINT, QUOTED);
+			Inquiry<Bond> quoted = _inquiryStore.Get(handle);
+			requoteCount++;
+			InquiryConnector<T>::Generate_Instance()->Publish(quoted);
+		}
+	}
+
+	// Get the number of revised quotes sent
+	long GetRequoteCount() const
+	{
+		return requoteCount;
+	}
+
+	// Get the store of open inquiries
+	const InquiryStore<Bond>& GetStore() const
+	{
+		return _inquiryStore;
 	}
 
 	void AddListener(ServiceListener<Inquiry<Bond>> *listener) override {
@@ -183,42 +505,51 @@ public:
 	}
 private:
 
-	std::map<std::string, Inquiry<Bond>> _inquiryData;
+	InquiryStore<Bond> _inquiryStore;
 
 	std::vector<ServiceListener<Inquiry<Bond>>*> _listeners;
 
-	InquiryService() { }
+	std::map<std::string, const SeqLock<Price<Bond>>*> _priceSlots;
 
-};
+	double spreadTicksPerMillion;
+	double maxSpreadTicks;
+	long maxQuantity;
+	long requoteCount;
 
-template<typename T>
-class InquiryServiceListener : public ServiceListener<Inquiry<T>>
-{
-public:
-	static InquiryServiceListener<T>* Generate_Instance()
+	// scratch for Requote, reused across price updates
+	vector<InquiryStore<Bond>::Handle> RequoteHandles;
+	vector<double> RequoteQuantity;
+	vector<double> RequoteSign;
+	vector<double> RequoteTicks;
+	vector<double> RequoteChange;
+
+	InquiryService()
 	{
-		static InquiryServiceListener<T> instance;
-		return &instance;
+		// a quarter tick wider per million, at most two ticks either side of the mid
+		spreadTicksPerMillion = 0.25;
+		maxSpreadTicks = 2;
+		maxQuantity = 100000000;
+		requoteCount = 0;
 	}
 
-	virtual void ProcessAdd(Inquiry<T> &_inquiry)
+	// Get the price slot of a product, looked up once and kept
+	const SeqLock<Price<Bond>>* GetPriceSlot(const string &id)
 	{
-		auto inquiryconnector = InquiryConnector<T>::Generate_Instance();
-		inquiryconnector->Publish(_inquiry, 100);
+		auto it = _priceSlots.find(id);
+		if (it != _priceSlots.end()) return it->second;
+		const SeqLock<Price<Bond>> *slot = PricingService<Bond>::Generate_Instance()->GetSlot(id);
+		if (slot != nullptr) _priceSlots.insert(pair<string, const SeqLock<Price<Bond>>*>(id, slot));
+		return slot;
 	}
 
-	virtual void ProcessRemove(Inquiry<T> &data) {}
-
-	virtual void ProcessUpdate(Inquiry<T> &data) {}
-
-private:
-	InquiryService<T>* _bondInquiryService;
-	//InquiryConnector<T>* inquiryconnector;
-
-	InquiryServiceListener()
+	// Tell the listeners about an inquiry in a final state and drop it from the store
+	void Finish(InquiryStore<Bond>::Handle handle)
 	{
-		_bondInquiryService = InquiryService<T>::Generate_Instance();
+		Inquiry<Bond> finished = _inquiryStore.Get(handle);
+		_inquiryStore.Erase(handle);
+		PushToListeners(finished);
 	}
+
 };
 
 template<typename T>
@@ -231,7 +562,35 @@ public:
 		return &instance;
 	}
 
-	virtual void Publish(Inquiry<T> &data) {}
+	// Send a quote to the client. The client answers later, on AnswerQuotes; until then a
+	// revised quote replaces the one it holds for the inquiry.
+	virtual void Publish(Inquiry<T> &data)
+	{
+		auto it = QuoteMap.find(data.GetInquiryId());
+		if (it == QuoteMap.end()) QuoteMap.emplace(data.GetInquiryId(), data);
+		else it->second = data;
+	}
+
+	// Deliver the client's answers to the quotes it holds, oldest inquiry first: the client
+	// here accepts the latest quote of every inquiry, answering DONE. Returns the number answered.
+	int AnswerQuotes()
+	{
+		map<IdType, Inquiry<T>> answers;
+		answers.swap(QuoteMap);
+		for (auto it = answers.begin(); it != answers.end(); ++it)
+		{
+			it->second.SetState(DONE);
+			_bondInquiryServiceservice->OnMessage(it->second);
+		}
+		std::cout << "allinquiries.txt Generated." << std::endl;
+		return (int)answers.size();
+	}
+
+	// Get the number of quotes the client has not answered yet
+	size_t GetPendingQuotes() const
+	{
+		return QuoteMap.size();
+	}
 
 	void Subscribe() {
 
@@ -254,30 +613,24 @@ public:
 			return result;
 		};
 
-		static int inquiryId = 1; inquiryId++;
 		ifstream is("input/inquiries.txt");
 		string line;
 		getline(is, line); 	// skip the header
 		while (getline(is, line))
 		{
 			std::vector<std::string> elems = SplitLine(line);
-			std::string cus_ip, side, quantity, price, state;
+			std::string cus_ip, side, quantity, price, state, client;
 			cus_ip = elems[0]; side = elems[1]; quantity = elems[2];
 			price = elems[3]; state = elems[4];
-			InquiryState _state;
-			if (state == "RECEIVED") _state = InquiryState::QUOTED;
+			if (elems.size() > 5) client = elems[5];
+			InquiryState _state = RECEIVED;
+			if (state == "DONE") _state = DONE;
+			else if (state == "CUSTOMER_REJECTED") _state = CUSTOMER_REJECTED;
 			auto bond = _bondProductService->GetData(cus_ip);
-			Inquiry<Bond> inq(std::to_string(inquiryId), bond, (side == "BUY" ? Side::BUY : Side::SELL),
-				static_cast<long>(std::stod(quantity)), std::stod(price), _state);
+			Inquiry<Bond> inq(IdGenerator::Inquiries().Next(), bond, (side == "BUY" ? Side::BUY : Side::SELL),
+				static_cast<long>(std::stod(quantity)), std::stod(price), _state, client);
 			_bondInquiryServiceservice->OnMessage(inq);
 		}
-		std::cout << "allinquiries.txt Generated." << std::endl;
-	}
-
-	void Publish(Inquiry<T> &_data, double quote)
-	{
-		//_bondInquiryServiceservice->SetQuoted(_data);
-		//_bondInquiryServiceservice->OnMessage(_data);
 	}
 
 	InquiryService<Bond>* GetService() 
@@ -293,11 +646,42 @@ private:
 	}
 	InquiryService<Bond>* _bondInquiryServiceservice;
 	BondProductService* _bondProductService;
+	map<IdType, Inquiry<T>> QuoteMap;    // quotes the client holds, by inquiry id (ids rise in arrival order)
 };
 
+/**
+* Listener on the PricingService that re-quotes the open inquiries on every repriced product.
+* Type T is the product type.
+*/
 template<typename T>
-Inquiry<T>::Inquiry(string _inquiryId, const T &_product, Side _side, long _quantity, double _price, InquiryState _state) :
-  product(_product)
+class InquiryRequoteListener : public ServiceListener<Price<T>>
+{
+public:
+	static InquiryRequoteListener<T>* Generate_Instance()
+	{
+		static InquiryRequoteListener<T> instance;
+		return &instance;
+	}
+
+	virtual void ProcessAdd(Price<T> &data)
+	{
+		_bondInquiryService->Requote(data);
+	}
+
+	virtual void ProcessRemove(Price<T> &data) {}
+	virtual void ProcessUpdate(Price<T> &data) {}
+
+private:
+	InquiryService<T>* _bondInquiryService;
+	InquiryRequoteListener()
+	{
+		_bondInquiryService = InquiryService<T>::Generate_Instance();
+	}
+};
+
+template<typename T>
+Inquiry<T>::Inquiry(IdType _inquiryId, const T &_product, Side _side, long _quantity, double _price, InquiryState _state, const string &_client) :
+  client(_client), product(_product)
 {
   inquiryId = _inquiryId;
   side = _side;
@@ -307,11 +691,17 @@ Inquiry<T>::Inquiry(string _inquiryId, const T &_product, Side _side, long _quan
 }
 
 template<typename T>
-const string& Inquiry<T>::GetInquiryId() const
+IdType Inquiry<T>::GetInquiryId() const
 {
   return inquiryId;
 }
 
+template<typename T>
+const string& Inquiry<T>::GetClient() const
+{
+  return client;
+}
+
 template<typename T>
 const T& Inquiry<T>::GetProduct() const
 {
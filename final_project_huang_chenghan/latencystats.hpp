@@ -0,0 +1,128 @@
+/**
+* latencystats.hpp
+* Latency statistics in constant memory: count, min, max, mean and percentiles.
+*
+* @author Chenghan Huang
+*/
+#ifndef LATENCY_STATS_HPP
+#define LATENCY_STATS_HPP
+
+#include <cstdint>
+#include <iostream>
+
+using namespace std;
+
+/**
+* Latency samples in nanoseconds, kept as a histogram of 8 linear sub-buckets per power of two,
+* so percentiles are exact to within 12.5% however many samples are recorded.
+*/
+class LatencyStats
+{
+
+public:
+
+	LatencyStats()
+	{
+		Reset();
+	}
+
+	// Record one sample
+	void Record(uint64_t nanos)
+	{
+		buckets[Bucket(nanos)]++;
+		if (count == 0 || nanos < minimum) minimum = nanos;
+		if (nanos > maximum) maximum = nanos;
+		total += nanos;
+		count++;
+	}
+
+	// Forget every sample
+	void Reset()
+	{
+		for (int i = 0; i < BUCKETS; i++) buckets[i] = 0;
+		count = 0;
+		total = 0;
+		minimum = 0;
+		maximum = 0;
+	}
+
+	// Get the number of samples
+	uint64_t GetCount() const
+	{
+		return count;
+	}
+
+	// Get the smallest sample
+	uint64_t GetMin() const
+	{
+		return minimum;
+	}
+
+	// Get the largest sample
+	uint64_t GetMax() const
+	{
+		return maximum;
+	}
+
+	// Get the mean sample
+	double GetMean() const
+	{
+		return (count > 0 ? (double)total / count : 0);
+	}
+
+	// Get an upper bound of the p-th percentile, p in [0, 100]
+	uint64_t GetPercentile(double p) const
+	{
+		if (count == 0) return 0;
+		uint64_t rank = (uint64_t)(p / 100 * count);
+		if (rank >= count) rank = count - 1;
+		uint64_t seen = 0;
+		for (int i = 0; i < BUCKETS; i++)
+		{
+			seen += buckets[i];
+			if (seen > rank)
+			{
+				uint64_t bound = UpperBound(i);
+				return (bound < maximum ? bound : maximum);
+			}
+		}
+		return maximum;
+	}
+
+	friend ostream& operator << (ostream& os, const LatencyStats& s)
+	{
+		os << "n=" << s.GetCount() << " min=" << s.GetMin() << "ns mean=" << (uint64_t)s.GetMean()
+			<< "ns p50=" << s.GetPercentile(50) << "ns p99=" << s.GetPercentile(99) << "ns max=" << s.GetMax() << "ns";
+		return os;
+	}
+
+private:
+	static const int SUB_BUCKETS = 8;
+	static const int BUCKETS = 64 * SUB_BUCKETS;
+
+	uint64_t buckets[BUCKETS];
+	uint64_t count;
+	uint64_t total;
+	uint64_t minimum;
+	uint64_t maximum;
+
+	// Values below 8 get a bucket each; above, 8 buckets per power of two
+	static int Bucket(uint64_t nanos)
+	{
+		if (nanos < SUB_BUCKETS) return (int)nanos;
+		int exponent = 63 - __builtin_clzll(nanos);
+		int sub = (int)((nanos >> (exponent - 3)) & (SUB_BUCKETS - 1));
+		return (exponent - 2) * SUB_BUCKETS + sub;
+	}
+
+	static uint64_t UpperBound(int bucket)
+	{
+		if (bucket < SUB_BUCKETS) return (uint64_t)bucket;
+		int exponent = bucket / SUB_BUCKETS + 2;
+		uint64_t sub = bucket % SUB_BUCKETS;
+		return ((SUB_BUCKETS + sub + 1) << (exponent - 3)) - 1;
+	}
+
+};
+
+#endif
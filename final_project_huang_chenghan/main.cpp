@@ -18,9 +18,16 @@
 #include "algoexecutionservicelistener.hpp"
 #include "streamingservice.hpp"
 #include "streamingservicelistener.hpp"
+#include "scenarioriskservice.hpp"
+#include "quoteskewservice.hpp"
+#include "pricestreampublisher.hpp"
+#include "guiservice.hpp"
 #include "DataGenerator.hpp"
+#include "alloccounter.hpp"
 #include <fstream>
 #include <iostream>
+#include <chrono>
+#include <cstdlib>
 
 
 using namespace std;
@@ -29,23 +36,62 @@ class Bond;
 
 int main()
 {
+    // every process that can meet another's ids runs its own session, given as ID_SESSION;
+    // a standalone run takes session 0, whose ids render as plain numbers
+    const char *id_session = getenv("ID_SESSION");
+    long session = (id_session != nullptr ? strtol(id_session, nullptr, 10) : 0);
+    if (session < 0 || session >= IdGenerator::EXTERNAL_SESSION)
+    {
+        std::cout << "ID_SESSION must be between 0 and " << IdGenerator::EXTERNAL_SESSION - 1 << "." << std::endl;
+        return 1;
+    }
+    IdGenerator::StartProcessSession((uint16_t)session);
+
     //Generate data and print them into the input folder
     GenerateData();
 
     //Calculate corresponding data and print them into the output folder
-    // priceservice ->algostreaming ->streaming ->historicaldataservice
+    // wire every service first, so no listener misses data from a feed read before it was attached
+    // priceservice ->algostreaming ->streaming ->historicaldataservice, wired at compile time
     auto BondPricingServiceConnector = PricingServiceConnector::Generate_Instance();
     auto BondPricingService = BondPricingServiceConnector->GetService();
-    auto BondPricingServiceListener = PricingServiceListener<Bond>::Generate_Instance();
-    BondPricingService->AddListener(BondPricingServiceListener);
-    auto BondAlgoStreamingServiceListener = AlgoStreamingServiceListener<Bond>::Generate_Instance();
-    auto BondAlgoStreamingService = BondAlgoStreamingServiceListener->GetService();
-    BondAlgoStreamingService->AddListener(BondAlgoStreamingServiceListener);
-    auto BondStreamingServiceListener = StreamingServiceListener<Bond>::Generate_Instance();
-    auto BondStreamingService = BondStreamingServiceListener->GetService();
-    BondStreamingService->AddListener(BondStreamingServiceListener);
-    // read the data and output stream.txt
-    BondPricingServiceConnector->Subscribe();
+    Pipeline<PricingStage<Bond>, AlgoStreamingStage<Bond>, StreamingStage<Bond>> BondPricingPipeline;
+    auto BondStreamingService = StreamingService<Bond>::Generate_Instance();
+    // fan the two-way prices out to clients over a shared-memory ring and/or UDP, each only when
+    // configured: PRICE_STREAM_RING=<ring name>, PRICE_STREAM_UDP=<group>:<port> (127.0.0.1 for loopback)
+    auto BondPriceStreamFanoutConnector = PriceStreamFanoutConnector::Generate_Instance();
+    const char *stream_ring = getenv("PRICE_STREAM_RING");
+    const char *stream_udp = getenv("PRICE_STREAM_UDP");
+    if (stream_ring != nullptr && *stream_ring != '\0')
+    {
+        BondPriceStreamFanoutConnector->EnableRing(stream_ring, 4096);
+        BondStreamingService->SetConnector(BondPriceStreamFanoutConnector);
+    }
+    if (stream_udp != nullptr && *stream_udp != '\0')
+    {
+        string address(stream_udp);
+        size_t colon = address.rfind(':');
+        int port = (colon == string::npos ? 0 : atoi(address.c_str() + colon + 1));
+        if (port <= 0 || port > 65535)
+        {
+            std::cout << "PRICE_STREAM_UDP must be <group>:<port>, not " << address << "; UDP left off." << std::endl;
+        }
+        else
+        {
+            BondPriceStreamFanoutConnector->EnableUdp(address.substr(0, colon), (uint16_t)port, false);
+            BondStreamingService->SetConnector(BondPriceStreamFanoutConnector);
+        }
+    }
+    // only stream moves of a tick or more, or once a second otherwise; the heartbeat sends a
+    // held stream on to streaming.txt once its second is up, even if no price follows
+    BondStreamingService->SetThrottle(true, 1, 1000);
+    BondStreamingService->StartHeartbeat(BondPricingPipeline.GetRest().GetRest());
+    // pricingservice -> guiservice: snapshot the latest prices to gui.txt every 300ms
+    auto BondGUIServiceListener = GUIServiceListener<Bond>::Generate_Instance();
+    BondPricingService->AddListener(BondGUIServiceListener);
+    auto BondGUIService = BondGUIServiceListener->GetService();
+    BondGUIService->SetThrottle(300);
+    BondGUIService->Start();
 
     // marketdataservice ->algoexecution -> execution -> historicaldataservice
 	auto BondMarketDataServiceConnector = MarketDataConnector<Bond>::Generate_Instance();
@@ -55,11 +101,11 @@ int main()
 	auto BondAlgoExecutionServiceListener = AlgoExecutionServiceListener<Bond>::Generate_Instance();
 	auto BondAlgoExecutionService = BondAlgoExecutionServiceListener->GetService();
     BondAlgoExecutionService->AddListener(BondAlgoExecutionServiceListener);
+    // work every aggressing order as a TWAP: four market slices, two order books apart
+    BondAlgoExecutionService->SetSlicing(TWAP, 4, 2, 1000000);
 	auto BondExecutionServiceListener = ExecutionServiceListener<Bond>::Generate_Instance();
 	auto BondExecutionService = BondExecutionServiceListener->GetService();
     BondExecutionService->AddListener(BondExecutionServiceListener);
-	// read the data and output executions.txt
-    BondMarketDataServiceConnector->Subscribe();
 
     // tradingbookingservice -> positionservice -> riskservice -> historicaldataservice
     auto BondTradeBookingServiceConnector = TradeBookingConnector::Generate_Instance();
@@ -72,18 +118,79 @@ int main()
     auto BondRiskServiceListener = RiskServiceListener<Bond>::Generate_Instance();
     auto BondRiskService = BondRiskServiceListener->GetService();
     BondRiskService->AddListener(BondRiskServiceListener);
-    // read the data and output risk.txt
-    BondTradeBookingServiceConnector->Subscribe();
+    // positionservice, riskservice -> quoteskewservice -> algostreaming
+    auto BondQuoteSkewService = QuoteSkewService<Bond>::Generate_Instance();
+    if (!BondQuoteSkewService->LoadParameters("input/skew.txt"))
+    {
+        std::cout << "input/skew.txt could not be read, quoting with the default skew parameters." << std::endl;
+    }
+    BondPositionService->AddListener(BondQuoteSkewService);
+    BondRiskService->AddListener(BondQuoteSkewService);
+    // publish risk at most once per product every 10 position updates or 100ms
+    BondRiskService->SetConflation(true, 10, 100);
+    // execution -> tradebookingservice: book our own fills 16 at a time, none held over 100us
+    BondExecutionService->SetTradeBooking(BondTradeBookingService, 16, 100);
 
-	// inquiryservice -> historicaldataservice
+	// inquiryservice -> quote from pricingservice -> historicaldataservice
 	auto BondInquiryServiceConnector = InquiryConnector<Bond>::Generate_Instance();
 	auto BondInquiryService = BondInquiryServiceConnector->GetService();
-	auto BondInquriyServiceListener = InquiryServiceListener<Bond>::Generate_Instance();
 	auto BondHistoricalInquriyServiceListener = BondHistoricalInquiryServiceListener::Generate_Instance();
-    BondInquiryService->AddListener(BondInquriyServiceListener);
     BondInquiryService->AddListener(BondHistoricalInquriyServiceListener);
-	// read the data and output inquiry.txt
+    // pricingservice -> inquiryservice: re-quote open inquiries when their product is repriced
+    BondPricingService->AddListener(InquiryRequoteListener<Bond>::Generate_Instance());
+
+    // read the prices and output streaming.txt; the inquiries come in halfway through, are
+    // quoted from the prices so far and re-quoted by the rest before the clients answer
+    uint64_t price_allocations = AllocCounter::GetCount();
+    BondPricingServiceConnector->Subscribe(BondPricingPipeline, 300);
+    uint64_t inquiry_allocations = AllocCounter::GetCount();
     BondInquiryServiceConnector->Subscribe();
+    price_allocations += AllocCounter::GetCount() - inquiry_allocations;    // not the prices' own
+    BondPricingServiceConnector->Subscribe(BondPricingPipeline);
+    BondStreamingService->StopHeartbeat();
+    BondPricingPipeline.Flush();
+    std::cout << BondStreamingService->GetPublishedCount() << " price streams published, "
+              << BondStreamingService->GetSuppressedCount() << " suppressed." << std::endl;
+    std::cout << AllocCounter::PerMessage(price_allocations, BondPricingServiceConnector->GetMessageCount())
+              << " allocations per price." << std::endl;
+
+	// read the market data and output executions.txt, booking the fills
+    uint64_t book_allocations = AllocCounter::GetCount();
+    BondMarketDataServiceConnector->Subscribe();
+    // the books have run out: send the slices still scheduled
+    while (BondAlgoExecutionService->GetScheduledSlices() > 0) BondAlgoExecutionService->OnTimer();
+    BondExecutionService->FlushTrades();
+    std::cout << AllocCounter::PerMessage(book_allocations, BondMarketDataServiceConnector->GetMessageCount())
+              << " allocations per order book." << std::endl;
+    std::cout << "fill to position latency: " << BondExecutionService->GetBookingLatency() << std::endl;
+
+    // read the trades and output risk.txt
+    uint64_t trade_allocations = AllocCounter::GetCount();
+    BondTradeBookingServiceConnector->Subscribe();
+    BondRiskService->Flush();
+    std::cout << AllocCounter::PerMessage(trade_allocations, BondTradeBookingServiceConnector->GetMessageCount())
+              << " allocations per trade." << std::endl;
+    std::cout << BondRiskService->GetUpdateCount() << " position updates conflated into "
+              << BondRiskService->GetPublishCount() << " risk records." << std::endl;
+
+    // positionservice -> scenarioriskservice
+    auto BondScenarioRiskService = ScenarioRiskService<Bond>::Generate_Instance();
+    auto scenarios = ScenarioRiskService<Bond>::StandardScenarios();
+    // valued as of the sample data's date, before the first of the sample bonds matures
+    date valuation_date(2017, Dec, 22);
+    auto scenario_start = std::chrono::steady_clock::now();
+    BondScenarioRiskService->RunScenarios(scenarios, valuation_date);
+    auto scenario_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - scenario_start).count();
+    std::cout << scenarios.size() << " risk scenarios repriced over " << BondScenarioRiskService->GetPositionCount()
+              << " positions (" << BondScenarioRiskService->GetMaturedCount() << " matured) in " << scenario_us << "us." << std::endl;
+
+	// the clients answer their latest quotes, output allinquiries.txt
+    int answered = BondInquiryServiceConnector->AnswerQuotes();
+    std::cout << answered << " inquiries answered after " << BondInquiryService->GetRequoteCount() << " re-quotes." << std::endl;
+
+    BondGUIService->Stop();
+    std::cout << BondGUIService->GetPublishedCount() << " GUI prices published in "
+              << BondGUIService->GetSnapshotCount() << " snapshots." << std::endl;
 
     return 0;
 }
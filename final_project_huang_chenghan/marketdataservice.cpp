@@ -0,0 +1,22 @@
+/**
+ * marketdataservice.cpp
+ * Defines the data types and Service for order book market data.
+ *
+ * @author Breman Thuraisingham
+ */
+#include "marketdataservice.hpp"
+
+BidOffer::BidOffer(const Order &_bidOrder, const Order &_offerOrder) :
+	bidOrder(_bidOrder), offerOrder(_offerOrder)
+{
+}
+
+const Order& BidOffer::GetBidOrder() const
+{
+	return bidOrder;
+}
+
+const Order& BidOffer::GetOfferOrder() const
+{
+	return offerOrder;
+}
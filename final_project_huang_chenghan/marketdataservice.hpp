@@ -11,8 +11,12 @@
 #include <string>
 #include <vector>
 #include <iostream>
+#include <fstream>
+#include <sstream>
 #include "soa.hpp"
 #include "products.hpp"
+#include "snapshottable.hpp"
+#include "arena.hpp"
 
 using namespace std;
 
@@ -89,42 +93,64 @@ private:
 
 /**
 * Order book with a bid and offer stack.
-* Type T is the product type.
+* Type T is the product type, Alloc the allocator of the stacks: a connector builds its
+* transient books with an ArenaAllocator, the services keep theirs with the default.
 */
-template<typename T>
+template<typename T, typename Alloc = allocator<Order>>
 class OrderBook
 {
 
 public:
 
+	typedef vector<Order, Alloc> Stack;
+
 	OrderBook() {}
 
-	// ctor for the order book
-	OrderBook(const T &_product, const vector<Order> &_bidStack, const vector<Order> &_offerStack);
+	// ctor for the order book; pass the stacks as rvalues to move them in
+	OrderBook(const T &_product, Stack _bidStack, Stack _offerStack);
+
+	// ctor copying a book held with another allocator
+	template<typename OtherAlloc>
+	explicit OrderBook(const OrderBook<T, OtherAlloc> &_orderbook) :
+		product(_orderbook.GetProduct()),
+		bidStack(_orderbook.GetBidStack().begin(), _orderbook.GetBidStack().end()),
+		offerStack(_orderbook.GetOfferStack().begin(), _orderbook.GetOfferStack().end())
+	{
+	}
+
+	// Copy in a book held with another allocator, reusing the capacity of the stacks
+	template<typename OtherAlloc>
+	OrderBook& Assign(const OrderBook<T, OtherAlloc> &_orderbook)
+	{
+		product = _orderbook.GetProduct();
+		bidStack.assign(_orderbook.GetBidStack().begin(), _orderbook.GetBidStack().end());
+		offerStack.assign(_orderbook.GetOfferStack().begin(), _orderbook.GetOfferStack().end());
+		return *this;
+	}
 
 	// Get the product
 	const T& GetProduct() const;
 
 	// Get the bid stack
-	const vector<Order>& GetBidStack() const;
+	const Stack& GetBidStack() const;
 
 	// Get the offer stack
-	const vector<Order>& GetOfferStack() const;
+	const Stack& GetOfferStack() const;
 
-	void AddBidStack(const vector<Order> &_bidStack)
+	void AddBidStack(const Stack &_bidStack)
 	{
 		bidStack.insert(bidStack.end(), _bidStack.begin(), _bidStack.end());
 	}
 
-	void AddOfferStack(const vector<Order> &_offerStack)
+	void AddOfferStack(const Stack &_offerStack)
 	{
 		offerStack.insert(offerStack.end(), _offerStack.begin(), _offerStack.end());
 	}
 
 private:
 	T product;
-	vector<Order> bidStack;
-	vector<Order> offerStack;
+	Stack bidStack;
+	Stack offerStack;
 
 };
 
@@ -132,6 +158,9 @@ private:
 * Market Data Service which distributes market data
 * Keyed on product identifier.
 * Type T is the product type.
+* OnMessage keeps the latest book of each product in MarketDataMap, moved in when the
+* connector passes it as an rvalue, and in a snapshot table that other threads read through
+* TryGet without blocking the market data thread.
 */
 template<typename T>
 class MarketDataService : public Service<string, OrderBook<T>>
@@ -170,10 +199,10 @@ public:
 	}
 
 	// Get the best bid/offer order
-	const BidOffer& GetBestBidOffer(OrderBook<T> orderbook)
+	BidOffer GetBestBidOffer(const OrderBook<T> &orderbook) const
 	{
-		vector<Order> bidStack = orderbook.GetBidStack();
-		vector<Order> offerStack = orderbook.GetOfferStack();
+		const vector<Order> &bidStack = orderbook.GetBidStack();
+		const vector<Order> &offerStack = orderbook.GetOfferStack();
 		double bestbidprice = bidStack[0].GetPrice();
 		double bestofferprice = offerStack[0].GetPrice();
 		Order bestbid, bestoffer;
@@ -193,17 +222,46 @@ public:
 				bestoffer = offerStack[i];
 			}
 		}
-		BidOffer* bestbidoffer = new BidOffer(bestbid, bestoffer);
-		return *bestbidoffer;
+		return BidOffer(bestbid, bestoffer);
 	}
 
 	// Aggregate the order book
 	OrderBook<T>& GetData(string productId) override
 	{
-		return MarketDataMap[productId];
+		return MarketDataMap.at(productId);
+	}
+
+	// Copy out the latest book of a product from any thread; false if none has arrived
+	bool TryGet(const string &productId, OrderBook<T> &orderbook) const
+	{
+		return BookSnapshots.TryGet(productId, orderbook);
 	}
 
 	virtual void OnMessage(OrderBook<T> &orderbook) override
+	{
+		PushToListeners(BookOrderBook(orderbook));
+	}
+
+	// Take a book the connector is done with, moving it into MarketDataMap
+	virtual void OnMessage(OrderBook<T> &&orderbook) override
+	{
+		PushToListeners(BookOrderBook(std::move(orderbook)));
+	}
+
+	// Take a book built in a connector's arena, copying it over the product's book in
+	// MarketDataMap, whose stacks already have the capacity after the first update
+	template<typename Alloc>
+	void OnMessage(const OrderBook<T, Alloc> &orderbook)
+	{
+		const string &id = orderbook.GetProduct().GetProductId();
+		auto it = MarketDataMap.find(id);
+		if (it == MarketDataMap.end()) it = MarketDataMap.emplace(id, OrderBook<T>(orderbook)).first;
+		else it->second.Assign(orderbook);
+		BookSnapshots.Store(it->first, it->second);
+		PushToListeners(it->second);
+	}
+
+	void PushToListeners(OrderBook<T> &orderbook)
 	{
 		for (int i = 0; i < ListenerList.size(); i++)
 		{
@@ -221,6 +279,22 @@ public:
 	{
 		return ListenerList;
 	}
+
+private:
+	SnapshotTable<string, OrderBook<T>> BookSnapshots;
+
+	// Keep a book as the latest of its product, copied or moved in as the caller passed it.
+	// Assigning over the previous book reuses the capacity of its stacks.
+	template<typename Book>
+	OrderBook<T>& BookOrderBook(Book &&orderbook)
+	{
+		const string &id = orderbook.GetProduct().GetProductId();
+		auto it = MarketDataMap.find(id);
+		if (it == MarketDataMap.end()) it = MarketDataMap.emplace(id, std::forward<Book>(orderbook)).first;
+		else it->second = std::forward<Book>(orderbook);
+		BookSnapshots.Store(it->first, it->second);
+		return it->second;
+	}
 };
 
 template<typename T>
@@ -237,13 +311,18 @@ public:
 
 	void Subscribe()
 	{
-		auto SplitLine = [](std::string& line)
+		// split a row into fields held in the row's arena
+		auto SplitLine = [](const std::string& line, vector<std::string, ArenaAllocator<std::string>> &fields)
 		{
-			stringstream enter_line(line);
-			std::string item;
-			std::vector<std::string> tmp;
-			while (getline(enter_line, item, ',')) 	tmp.push_back(item);
-			return tmp;
+			fields.clear();
+			size_t start = 0, end;
+			while (start < line.size())
+			{
+				end = line.find(',', start);
+				if (end == std::string::npos) end = line.size();
+				fields.emplace_back(line, start, end - start);
+				start = end + 1;
+			}
 		};
 		auto String2Price = [](std::string& str)
 		{
@@ -263,11 +342,16 @@ public:
 		getline(is, line);
 		for (int i = 0; i < 12; ++i)
 		{
+			// everything transient in the row lives in the arena, given back at the end of the row
+			ArenaScope row;
 			getline(is, line);
-			std::vector<std::string> elems = SplitLine(line);
+			vector<std::string, ArenaAllocator<std::string>> elems;
+			SplitLine(line, elems);
 			_cusip = elems[0];
 			PricingSide side;
-			vector<Order> bid_stack, offer_stack;
+			OrderBook<Bond, ArenaAllocator<Order>>::Stack bid_stack, offer_stack;
+			bid_stack.reserve(5);
+			offer_stack.reserve(5);
 			double price;	long quantity;
 			int idx = 1;
 			for (int k = 1; k <= 5; ++k)
@@ -287,14 +371,21 @@ public:
 				offer_stack.push_back(offer_order);
 			}
 
-			auto bond = _bondProductService->GetData(_cusip);
-			OrderBook<Bond> order_book(bond, bid_stack, offer_stack);
+			const Bond &bond = _bondProductService->GetData(_cusip);
+			OrderBook<Bond, ArenaAllocator<Order>> order_book(bond, std::move(bid_stack), std::move(offer_stack));
 			_bondMarketDataService->OnMessage(order_book);
+			messageCount++;
 		}
 		std::cout << "executions.txt Generated." << std::endl;
 	}
 
 
+	// Get the number of rows read so far
+	long GetMessageCount() const
+	{
+		return messageCount;
+	}
+
 	MarketDataService<T>* GetService()
 	{
 		return _bondMarketDataService;
@@ -303,48 +394,35 @@ public:
 private:
 	MarketDataService<T>* _bondMarketDataService;
 	BondProductService* _bondProductService;
+	long messageCount;
 	MarketDataConnector()
 	{
+		messageCount = 0;
 		_bondMarketDataService = MarketDataService<T>::Generate_Instance();
 		_bondProductService = BondProductService::Generate_Instance();
 	}
 };
 
-BidOffer::BidOffer(const Order &_bidOrder, const Order &_offerOrder) :
-	bidOrder(_bidOrder), offerOrder(_offerOrder)
-{
-}
-
-const Order& BidOffer::GetBidOrder() const
-{
-	return bidOrder;
-}
-
-const Order& BidOffer::GetOfferOrder() const
+template<typename T, typename Alloc>
+OrderBook<T, Alloc>::OrderBook(const T &_product, Stack _bidStack, Stack _offerStack) :
+	product(_product), bidStack(std::move(_bidStack)), offerStack(std::move(_offerStack))
 {
-	return offerOrder;
 }
 
-template<typename T>
-OrderBook<T>::OrderBook(const T &_product, const vector<Order> &_bidStack, const vector<Order> &_offerStack) :
-	product(_product), bidStack(_bidStack), offerStack(_offerStack)
-{
-}
-
-template<typename T>
-const T& OrderBook<T>::GetProduct() const
+template<typename T, typename Alloc>
+const T& OrderBook<T, Alloc>::GetProduct() const
 {
 	return product;
 }
 
-template<typename T>
-const vector<Order>& OrderBook<T>::GetBidStack() const
+template<typename T, typename Alloc>
+const typename OrderBook<T, Alloc>::Stack& OrderBook<T, Alloc>::GetBidStack() const
 {
 	return bidStack;
 }
 
-template<typename T>
-const vector<Order>& OrderBook<T>::GetOfferStack() const
+template<typename T, typename Alloc>
+const typename OrderBook<T, Alloc>::Stack& OrderBook<T, Alloc>::GetOfferStack() const
 {
 	return offerStack;
 }
@@ -9,39 +9,48 @@
 #include "products.hpp"
 #include "marketdataservice.hpp"
 #include "algoexecutionservice.hpp"
+#include "riskservice.hpp"
+#include "smartorderrouter.hpp"
+#include "venuefillmodel.hpp"
 
 using namespace std;
 
-template<typename T>
+template<typename T, typename Signal = TopOfBookSignal>
 class MarketDataServiceListener : public ServiceListener<OrderBook<T>>
 {
 public:
-	static MarketDataServiceListener<T>* Generate_Instance()
+	static MarketDataServiceListener<T, Signal>* Generate_Instance()
 	{
-		static MarketDataServiceListener<T> instance;
+		static MarketDataServiceListener<T, Signal> instance;
 		return &instance;
 	}
 
 	virtual void ProcessAdd(OrderBook<T> &data)
 	{
-		T _product = data.GetProduct();
-		BidOffer _bidoffer = marketdataservice->GetBestBidOffer(data);
-		if (algoexecutionservice->Aggress(_bidoffer))
-		{
-			ExecutionOrder<T> executionorder = algoexecutionservice->ConvertToExecutionOrder(_product, _bidoffer);
-		}
+		// every book update is one tick of the child order schedule, the fill booking and the risk conflation
+		algoexecutionservice->OnTimer();
+		executionservice->FlushExpiredTrades();
+		riskservice->FlushExpired();
+		// our market data is the consolidated book; each venue shows its share of it
+		venuefillmodel->UpdateDepth(data);
+		algoexecutionservice->Aggress(data);
 	}
 
 	void ProcessRemove(OrderBook<T> &data) {}  // No implementation
 	void ProcessUpdate(OrderBook<T> &data) {}  // No implementation
 
 private:
-	AlgoExecutionService<T>* algoexecutionservice;
-	MarketDataService<T>* marketdataservice;
+	AlgoExecutionService<T, Signal>* algoexecutionservice;
+	ExecutionService<T>* executionservice;
+	RiskService<T>* riskservice;
+	VenueFillModel<T>* venuefillmodel;
 
-	MarketDataServiceListener<T>()
+	MarketDataServiceListener()
 	{
-		algoexecutionservice = AlgoExecutionService<T>::Generate_Instance();
+		algoexecutionservice = AlgoExecutionService<T, Signal>::Generate_Instance();
+		executionservice = ExecutionService<T>::Generate_Instance();
+		riskservice = RiskService<T>::Generate_Instance();
+		venuefillmodel = VenueFillModel<T>::Generate_Instance();
 	}
 };
 
@@ -0,0 +1,77 @@
+/**
+* pipeline.hpp
+* Chains of services wired at compile time, without listener lists or virtual calls.
+*
+* @author Chenghan Huang
+*/
+#ifndef PIPELINE_HPP
+#define PIPELINE_HPP
+
+using namespace std;
+
+/**
+* A pipeline of stages declared as a type list, e.g. Pipeline<PricingStage<Bond>,
+* AlgoStreamingStage<Bond>, StreamingStage<Bond>>. Push hands a message to the first stage,
+* whose Process(data, next) passes what it makes on to next.Push, so every hop is a direct
+* call the compiler can inline. Flush gives each stage the chance to push out what it holds
+* back, through the stages after it. The empty Pipeline<> ends the chain and drops whatever
+* reaches it, so a service driven by Pipeline<> behaves as if it had no static stages.
+* Services keep their listener lists alongside, for subscribers added at run time.
+*/
+template<typename... Stages>
+class Pipeline;
+
+template<>
+class Pipeline<>
+{
+public:
+	template<typename V>
+	void Push(V &data) {}
+
+	void Flush() {}
+};
+
+template<typename Stage, typename... Rest>
+class Pipeline<Stage, Rest...>
+{
+public:
+	template<typename V>
+	void Push(V &data)
+	{
+		stage.Process(data, rest);
+	}
+
+	void Flush()
+	{
+		stage.Flush(rest);
+		rest.Flush();
+	}
+
+	// Get the first stage
+	Stage& GetStage()
+	{
+		return stage;
+	}
+
+	// Get the stages after the first
+	Pipeline<Rest...>& GetRest()
+	{
+		return rest;
+	}
+
+private:
+	Stage stage;
+	Pipeline<Rest...> rest;
+};
+
+/**
+* Base of stages holding nothing back, so with nothing to flush.
+*/
+class PipelineStage
+{
+public:
+	template<typename Next>
+	void Flush(Next &next) {}
+};
+
+#endif
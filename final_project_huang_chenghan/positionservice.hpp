@@ -13,6 +13,7 @@
 #include "soa.hpp"
 #include "tradebookingservice.hpp"
 #include "pricingservice.hpp"
+#include "snapshottable.hpp"
 //#include "products.hpp"
 
 
@@ -35,13 +36,14 @@ public:
   void AddPosition(const Trade<T> &_trade)
   {
 	  string id = _trade.GetBook();
+	  long quantity = (_trade.GetSide() == BUY ? _trade.GetQuantity() : -_trade.GetQuantity());
 	  if (positions.find(id) == positions.end())
 	  {
-		  positions.insert(pair<string, long>(id, _trade.GetQuantity()));
+		  positions.insert(pair<string, long>(id, quantity));
 	  }
 	  else
 	  {
-		  positions[id] += _trade.GetQuantity();
+		  positions[id] += quantity;
 	  }
   }
 
@@ -64,6 +66,8 @@ private:
  * Position Service to manage positions across multiple books and secruties.
  * Keyed on product identifier.
  * Type T is the product type.
+ * The latest position of each product is also kept in a snapshot table that other threads
+ * read through TryGet without blocking the booking thread.
  */
 template<typename T>
 class PositionService : public Service<string,Position <T> >
@@ -89,16 +93,46 @@ public:
 			Position<T> position(product);
 			position.AddPosition(trade);
 			PositionMap.insert(pair<string, Position<T>>(id, position));
+			PositionSnapshots.Store(id, position);
 			PushToListeners(position);
 		}
 		else
 		{
-			Position<T> position = PositionMap[id];
+			Position<T> &position = PositionMap[id];
 			position.AddPosition(trade);
+			PositionSnapshots.Store(id, position);
 			PushToListeners(position);
 		}
 	}
 
+	// Add a block of trades: the position of a product is looked up once for each run of
+	// its trades, and listeners get one batch with the position after every trade.
+	// BatchList keeps its positions between batches, so assigning over them reuses their books.
+	virtual void AddTradeBatch(const Trade<T> *const *trades, size_t count)
+	{
+		if (BatchList.size() < count) BatchList.resize(count);
+		auto it = PositionMap.end();
+		for (size_t i = 0; i < count; i++)
+		{
+			const string &id = trades[i]->GetProduct().GetProductId();
+			if (it == PositionMap.end() || it->first != id)
+			{
+				if (it != PositionMap.end()) PositionSnapshots.Store(it->first, it->second);
+				it = PositionMap.find(id);
+				if (it == PositionMap.end()) it = PositionMap.insert(pair<string, Position<T>>(id, Position<T>(trades[i]->GetProduct()))).first;
+			}
+			it->second.AddPosition(*trades[i]);
+			BatchList[i] = it->second;
+		}
+		if (it != PositionMap.end()) PositionSnapshots.Store(it->first, it->second);
+		if (count == 0) return;
+		for (int i = 0; i < ListenerList.size(); i++)
+		{
+			ServiceListener<Position<T>>* listener = ListenerList[i];
+			listener->ProcessAddBatch(BatchList.data(), count);
+		}
+	}
+
 	void PushToListeners(Position<T> &position)
 	{
 		for (int i = 0; i < ListenerList.size(); i++)
@@ -112,12 +146,18 @@ public:
 	{
 		T product = position.GetProduct();
 		string id = product.GetProductId();
-		PositionMap.insert(pair<string, Position<T>>(id, position));
+		if (PositionMap.insert(pair<string, Position<T>>(id, position)).second) PositionSnapshots.Store(id, position);
 	}
 
 	virtual Position<T>& GetData(string id)
 	{
-		return PositionMap[id];
+		return PositionMap.at(id);
+	}
+
+	// Copy out the latest position of a product from any thread; false if it has none
+	bool TryGet(const string &id, Position<T> &position) const
+	{
+		return PositionSnapshots.TryGet(id, position);
 	}
 
 	virtual void OnMessage(Position<T> &data) {}
@@ -131,6 +171,10 @@ public:
 	{
 		return ListenerList;
 	}
+
+private:
+	SnapshotTable<string, Position<T>> PositionSnapshots;
+	vector<Position<T>> BatchList;    // positions of the batch being added, kept for reuse
 };
 
 template<typename T>
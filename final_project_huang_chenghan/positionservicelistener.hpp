@@ -34,6 +34,11 @@ public:
 		_bondRiskService->AddPosition(data);
 	}
 
+	void ProcessAddBatch(Position<T> *data, size_t count)
+	{
+		_bondRiskService->AddPositionBatch(data, count);
+	}
+
 	void ProcessRemove(Position<T> &data) {}
 	void ProcessUpdate(Position<T> &data) {}
 
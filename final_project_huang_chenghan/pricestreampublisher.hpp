@@ -0,0 +1,336 @@
+/**
+* pricestreampublisher.hpp
+* Fan two-way prices out to clients as fixed-size binary packets over UDP multicast
+* and/or a shared-memory ring.
+*
+* @author Chenghan Huang
+*/
+#ifndef PRICE_STREAM_PUBLISHER_HPP
+#define PRICE_STREAM_PUBLISHER_HPP
+
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <stdexcept>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "soa.hpp"
+#include "products.hpp"
+#include "streamingservice.hpp"
+#include "shmring.hpp"
+
+using namespace std;
+
+/**
+* Wire format of one two-way price: 64 bytes, prices in ticks of 1/256th.
+* The sequence counts from 0 in every publisher session; a session is one run of the
+* publisher, numbered by its start time, so a receiver can tell a restart from a replay.
+*/
+struct PriceStreamPacket
+{
+	uint64_t sequence;
+	char productId[16];
+	int32_t bidTicks;
+	int32_t offerTicks;
+	int32_t bidVisibleQuantity;
+	int32_t bidHiddenQuantity;
+	int32_t offerVisibleQuantity;
+	int32_t offerHiddenQuantity;
+	int64_t timestamp;          // steady clock nanoseconds at publish
+	uint64_t session;           // system clock nanoseconds at publisher start
+};
+
+static_assert(sizeof(PriceStreamPacket) == 64, "PriceStreamPacket must stay one cache line");
+
+// Encode a price stream into a packet
+template<typename T>
+void EncodePriceStream(const PriceStream<T> &stream, uint64_t session, uint64_t sequence, PriceStreamPacket &packet)
+{
+	const string &id = stream.GetProduct().GetProductId();
+	memset(packet.productId, 0, sizeof(packet.productId));
+	memcpy(packet.productId, id.data(), id.size() < sizeof(packet.productId) - 1 ? id.size() : sizeof(packet.productId) - 1);
+	packet.session = session;
+	packet.sequence = sequence;
+	packet.bidTicks = (int32_t)lround(stream.GetBidOrder().GetPrice() * TICKS_PER_POINT);
+	packet.offerTicks = (int32_t)lround(stream.GetOfferOrder().GetPrice() * TICKS_PER_POINT);
+	packet.bidVisibleQuantity = (int32_t)stream.GetBidOrder().GetVisibleQuantity();
+	packet.bidHiddenQuantity = (int32_t)stream.GetBidOrder().GetHiddenQuantity();
+	packet.offerVisibleQuantity = (int32_t)stream.GetOfferOrder().GetVisibleQuantity();
+	packet.offerHiddenQuantity = (int32_t)stream.GetOfferOrder().GetHiddenQuantity();
+	packet.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Decode a packet back into a price stream, taking the bond from the product service
+inline PriceStream<Bond> DecodePriceStream(const PriceStreamPacket &packet, BondProductService *productService)
+{
+	const Bond &bond = productService->GetData(string(packet.productId));
+	PriceStreamOrder bid((double)packet.bidTicks / TICKS_PER_POINT, packet.bidVisibleQuantity, packet.bidHiddenQuantity, BID);
+	PriceStreamOrder offer((double)packet.offerTicks / TICKS_PER_POINT, packet.offerVisibleQuantity, packet.offerHiddenQuantity, OFFER);
+	return PriceStream<Bond>(bond, bid, offer);
+}
+
+/**
+* UDP sender for packets. In loopback mode packets go to 127.0.0.1 instead of the
+* multicast group, so publisher and subscriber can run on a host without multicast routing.
+*/
+class UdpPacketSender
+{
+
+public:
+
+	// ctor for a sender to group:port (or 127.0.0.1:port in loopback mode)
+	UdpPacketSender(const string &group, uint16_t port, bool loopback)
+	{
+		fd = socket(AF_INET, SOCK_DGRAM, 0);
+		if (fd < 0) throw runtime_error("cannot open UDP socket");
+		memset(&address, 0, sizeof(address));
+		address.sin_family = AF_INET;
+		address.sin_port = htons(port);
+		address.sin_addr.s_addr = inet_addr(loopback ? "127.0.0.1" : group.c_str());
+		unsigned char ttl = 1, loop = 1;
+		setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+		setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+		sendErrors = 0;
+	}
+
+	~UdpPacketSender()
+	{
+		close(fd);
+	}
+
+	// Send one packet; a failed send is counted, never retried
+	void Send(const void *data, size_t length)
+	{
+		if (sendto(fd, data, length, 0, (const sockaddr*)&address, sizeof(address)) != (ssize_t)length) sendErrors++;
+	}
+
+	// Get the number of failed sends
+	long GetSendErrors() const
+	{
+		return sendErrors;
+	}
+
+private:
+	int fd;
+	sockaddr_in address;
+	long sendErrors;
+
+	UdpPacketSender(const UdpPacketSender&);
+	UdpPacketSender& operator=(const UdpPacketSender&);
+
+};
+
+/**
+* UDP receiver for price stream packets, with gap detection on the packet sequence.
+* A packet from a later session than the one followed is a publisher restart: the receiver
+* follows the new session from its sequence 0. Packets of earlier sessions are stale and
+* dropped with the duplicates; datagrams that are not one packet long are skipped.
+*/
+class UdpPriceStreamReceiver
+{
+
+public:
+
+	// ctor for a receiver on port, joining group unless in loopback mode
+	UdpPriceStreamReceiver(const string &group, uint16_t port, bool loopback)
+	{
+		fd = socket(AF_INET, SOCK_DGRAM, 0);
+		if (fd < 0) throw runtime_error("cannot open UDP socket");
+		int reuse = 1;
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+		sockaddr_in address;
+		memset(&address, 0, sizeof(address));
+		address.sin_family = AF_INET;
+		address.sin_port = htons(port);
+		address.sin_addr.s_addr = htonl(INADDR_ANY);
+		if (bind(fd, (const sockaddr*)&address, sizeof(address)) != 0)
+		{
+			close(fd);
+			throw runtime_error("cannot bind UDP port");
+		}
+		if (!loopback)
+		{
+			ip_mreq membership;
+			membership.imr_multiaddr.s_addr = inet_addr(group.c_str());
+			membership.imr_interface.s_addr = htonl(INADDR_ANY);
+			setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership));
+		}
+		session = 0;
+		expected = 0;
+		gaps = 0;
+		duplicates = 0;
+		malformed = 0;
+		restarts = 0;
+	}
+
+	~UdpPriceStreamReceiver()
+	{
+		close(fd);
+	}
+
+	// Receive the next in-sequence packet; false if none is waiting (non-blocking)
+	bool Receive(PriceStreamPacket &packet)
+	{
+		for (;;)
+		{
+			// MSG_TRUNC gives the datagram's real length, so an oversized one is caught too
+			ssize_t length = recv(fd, &packet, sizeof(packet), MSG_DONTWAIT | MSG_TRUNC);
+			if (length < 0) return false;
+			if (length != (ssize_t)sizeof(packet))
+			{
+				malformed++;
+				continue;
+			}
+			if (packet.session != session)
+			{
+				if (packet.session < session)
+				{
+					duplicates++;
+					continue;
+				}
+				if (session != 0) restarts++;
+				session = packet.session;
+				expected = 0;
+			}
+			if (packet.sequence < expected)
+			{
+				duplicates++;
+				continue;
+			}
+			gaps += packet.sequence - expected;
+			expected = packet.sequence + 1;
+			return true;
+		}
+	}
+
+	// Get the number of packets missed
+	uint64_t GetGaps() const
+	{
+		return gaps;
+	}
+
+	// Get the number of stale or duplicate packets dropped
+	uint64_t GetDuplicates() const
+	{
+		return duplicates;
+	}
+
+	// Get the number of datagrams skipped for not being one packet long
+	uint64_t GetMalformed() const
+	{
+		return malformed;
+	}
+
+	// Get the number of publisher restarts seen
+	uint64_t GetRestarts() const
+	{
+		return restarts;
+	}
+
+private:
+	int fd;
+	uint64_t session;       // session followed, 0 before the first packet
+	uint64_t expected;
+	uint64_t gaps;
+	uint64_t duplicates;
+	uint64_t malformed;
+	uint64_t restarts;
+
+	UdpPriceStreamReceiver(const UdpPriceStreamReceiver&);
+	UdpPriceStreamReceiver& operator=(const UdpPriceStreamReceiver&);
+
+};
+
+/**
+* Publish-only connector fanning price streams out to clients.
+* Each stream is encoded once into a sequenced packet, written in place into the
+* shared-memory ring (readers on the same host consume it with zero copies) and sent over UDP.
+* Either transport can be left disabled.
+*/
+class PriceStreamFanoutConnector : public Connector<PriceStream<Bond>>
+{
+public:
+	static PriceStreamFanoutConnector* Generate_Instance()
+	{
+		static PriceStreamFanoutConnector instance;
+		return &instance;
+	}
+
+	// Send packets over UDP to group:port, or to localhost in loopback mode
+	void EnableUdp(const string &group, uint16_t port, bool loopback)
+	{
+		delete udp;
+		udp = new UdpPacketSender(group, port, loopback);
+	}
+
+	// Write packets into a shared-memory ring; an empty name keeps the ring in this process
+	void EnableRing(const string &name, uint64_t capacity)
+	{
+		delete ring;
+		ring = new ShmRing<PriceStreamPacket>(name, capacity, true);
+	}
+
+	// Get the shared-memory ring, or nullptr if disabled
+	const ShmRing<PriceStreamPacket>* GetRing() const
+	{
+		return ring;
+	}
+
+	void Publish(PriceStream<Bond> &data)
+	{
+		if (ring != nullptr)
+		{
+			PriceStreamPacket *packet = ring->Claim();
+			EncodePriceStream(data, session, sequence, *packet);
+			ring->Commit();
+			if (udp != nullptr) udp->Send(packet, sizeof(PriceStreamPacket));
+		}
+		else if (udp != nullptr)
+		{
+			PriceStreamPacket packet;
+			EncodePriceStream(data, session, sequence, packet);
+			udp->Send(&packet, sizeof(PriceStreamPacket));
+		}
+		sequence++;
+	}
+
+	void Subscribe() {}  // implement nothing, publish-only
+
+	// Get the number of packets published
+	uint64_t GetSequence() const
+	{
+		return sequence;
+	}
+
+	// Get the session stamped on every packet of this run
+	uint64_t GetSession() const
+	{
+		return session;
+	}
+
+private:
+	UdpPacketSender* udp;
+	ShmRing<PriceStreamPacket>* ring;
+	uint64_t session;
+	uint64_t sequence;
+
+	PriceStreamFanoutConnector()
+	{
+		udp = nullptr;
+		ring = nullptr;
+		session = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+		sequence = 0;
+	}
+
+	~PriceStreamFanoutConnector()
+	{
+		delete udp;
+		delete ring;
+	}
+};
+
+#endif
@@ -11,7 +11,17 @@
 #include <vector>
 #include <map>
 #include <iostream>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cassert>
+#include <climits>
+#include <fstream>
+#include <type_traits>
 #include "algostreamingservice.hpp"
+#include "snapshottable.hpp"
+#include "pipeline.hpp"
+#include "arena.hpp"
 #include "soa.hpp"
 #include "products.hpp"
 
@@ -22,6 +32,10 @@ class AlgoStreamingService;
 
 /**
 * A price object consisting of mid and bid/offer spread.
+* Trivially copyable: the product is held by pointer and must outlive the price, so build
+* prices from the references BondProductService vends, never from a temporary or a local
+* copy; mid and spread are integer ticks. A default-constructed price has no product until
+* one is assigned over it, and GetProduct must not be called on it before then.
 * Type T is the product type.
 */
 template<typename T>
@@ -30,11 +44,17 @@ class Price
 
 public:
 
-	Price() :product(T()) {}
+	Price() : product(nullptr), midTicks(0), bidOfferSpreadTicks(0) {}
 
 	// ctor for a price
 	Price(const T &_product, double _mid, double _bidOfferSpread);
 
+	// a temporary product would dangle as soon as the price is built
+	Price(const T &&_product, double _mid, double _bidOfferSpread) = delete;
+
+	// ctor for a price in ticks
+	Price(const T *_product, int32_t _midTicks, int32_t _bidOfferSpreadTicks);
+
 	// Get the product
 	const T& GetProduct() const;
 
@@ -44,17 +64,27 @@ public:
 	// Get the bid/offer spread around the mid
 	double GetBidOfferSpread() const;
 
+	// Get the mid price in ticks
+	int32_t GetMidTicks() const;
+
+	// Get the bid/offer spread in ticks
+	int32_t GetBidOfferSpreadTicks() const;
+
 private:
-	const T& product;
-	double mid;
-	double bidOfferSpread;
+	const T* product;
+	int32_t midTicks;
+	int32_t bidOfferSpreadTicks;
 
 };
 
+static_assert(std::is_trivially_copyable<Price<Bond> >::value, "Price must stay trivially copyable");
+
 /**
 * Pricing Service managing mid prices and bid/offers.
 * Keyed on product identifier.
 * Type T is the product type.
+* Besides PriceMap (pricing thread only), the latest price of each product is kept in a
+* seqlock slot that other threads read through TryGet/GetSlot without blocking the writer.
 */
 template<typename T>
 class PricingService : public Service<string, Price <T> >
@@ -71,18 +101,50 @@ public:
 
 	void BookPrice(Price<T> &data)
 	{
-		T BondProduct = data.GetProduct();
-		PriceMap.insert(pair<string, Price<T>>(BondProduct.GetProductId(), data));
+		const string &id = data.GetProduct().GetProductId();
+		auto it = PriceMap.find(id);
+		if (it == PriceMap.end())
+		{
+			PriceMap.emplace(id, data);
+		}
+		else
+		{
+			it->second = data;
+		}
+		PriceSnapshots.Store(id, data);
+	}
+
+	// Get the latest price slot of a product, or nullptr if it has never been priced.
+	// The slot lives as long as the service, so readers can look it up once and keep it.
+	const SeqLock<Price<T>>* GetSlot(const string &id) const
+	{
+		return PriceSnapshots.GetSlot(id);
+	}
+
+	// Copy out the latest price of a product from any thread; false if it has never been priced
+	bool TryGet(const string &id, Price<T> &price, uint64_t *sequence = nullptr) const
+	{
+		return PriceSnapshots.TryGet(id, price, sequence);
 	}
 
+	// Get the price of a product; throws out_of_range if it has never been priced (pricing thread only)
 	virtual Price<T>& GetData(string id)
 	{
-		return PriceMap[id];
+		return PriceMap.at(id);
 	}
 
 	virtual void OnMessage(Price<T> &data)
+	{
+		Pipeline<> none;
+		OnMessage(data, none);
+	}
+
+	// Book a price and pass it down a static pipeline, then to the listeners
+	template<typename Next>
+	void OnMessage(Price<T> &data, Next &next)
 	{
 		BookPrice(data);
+		next.Push(data);
 		for (int i = 0; i < ListenerList.size();i++)
 		{
 			ServiceListener<Price<T>>* listener = ListenerList[i];
@@ -99,6 +161,9 @@ public:
 	{
 		return ListenerList;
 	}
+
+private:
+	SnapshotTable<string, Price<T>> PriceSnapshots;
 };
 
 
@@ -115,24 +180,42 @@ public:
 
 	void Subscribe()
 	{
-		auto SplitLine = [](std::string& line)
+		Pipeline<> none;
+		Subscribe(none);
+	}
+
+	// Read the prices, passing each down a static pipeline as well as to the listeners
+	template<typename Next>
+	void Subscribe(Next &next)
+	{
+		Subscribe(next, LONG_MAX);
+	}
+
+	// Read up to maxRows more prices, carrying on from where the last call stopped, so other
+	// feeds can be read in between; returns the number of rows read
+	template<typename Next>
+	long Subscribe(Next &next, long maxRows)
+	{
+		// split a row into fields held in the row's arena
+		auto SplitLine = [](const std::string& line, vector<std::string, ArenaAllocator<std::string>> &fields)
 		{
-			stringstream enter_line(line);
-			std::string item;
-			std::vector<std::string> tmp;
-			while (getline(enter_line, item, ',')) 	tmp.push_back(item);
-			return tmp;
+			fields.clear();
+			size_t start = 0, end;
+			while (start < line.size())
+			{
+				end = line.find(',', start);
+				if (end == std::string::npos) end = line.size();
+				fields.emplace_back(line, start, end - start);
+				start = end + 1;
+			}
 		};
 		auto String2Price = [](std::string& str)
 		{
+			// handle-xyz: the handle up to the '-', then the 32nds xy and the 8ths z ('+' for 4),
+			// read in place rather than through substrings
 			size_t idx = str.find_first_of('-');
-			istringstream iss;
-			iss.str(str.substr(0, idx));
-			double result = 0;
-			iss >> result;
-			iss.str(str.substr(idx + 1, 2));
-			int num1=0;
-			iss >> num1;
+			double result = std::strtod(str.c_str(), nullptr);
+			int num1 = (str[idx + 1] - '0') * 10 + (str[idx + 2] - '0');
 			char ch = str[str.size() - 1];
 			if (ch == '+') ch = '4';
 			int num2 = ch - '0';
@@ -140,20 +223,36 @@ public:
 			return result;
 		};
 
-		ifstream is("input/prices.txt");
 		string line;
-		std::getline(is, line); 	// skip the header
+		if (!is.is_open())
+		{
+			is.open("input/prices.txt");
+			std::getline(is, line); 	// skip the header
+		}
 		string _cusip, _mid, _bidofferspread;
-		while (std::getline(is, line)) {
-			std::vector<std::string> elems = SplitLine(line);
+		long rows = 0;
+		while (rows < maxRows && std::getline(is, line)) {
+			// the row's fields live in the arena, given back at the end of the row
+			ArenaScope row;
+			vector<std::string, ArenaAllocator<std::string>> elems;
+			SplitLine(line, elems);
 			_cusip = elems[0]; _mid = elems[1]; _bidofferspread = elems[2];
 			double mid_price = String2Price(_mid);
 			double spread = String2Price(_bidofferspread);
-			auto bond = _bondProductService->GetData(_cusip);
+			const Bond &bond = _bondProductService->GetData(_cusip);
 			Price<Bond> price(bond, mid_price, spread);
-			_bondPricingService->OnMessage(price);
+			_bondPricingService->OnMessage(price, next);
+			messageCount++;
+			rows++;
 		}
-		std::cout << "streaming.txt Generated." << std::endl;
+		if (rows < maxRows) std::cout << "streaming.txt Generated." << std::endl;
+		return rows;
+	}
+
+	// Get the number of rows read so far
+	long GetMessageCount() const
+	{
+		return messageCount;
 	}
 
 	PricingService<Bond>* GetService()
@@ -164,12 +263,15 @@ public:
 private:
 	PricingServiceConnector()
 	{
+		messageCount = 0;
 		_bondPricingService = PricingService<Bond>::Generate_Instance();
 		_bondProductService = BondProductService::Generate_Instance();
 	}
 
 	PricingService<Bond> *_bondPricingService;;
 	BondProductService* _bondProductService;
+	ifstream is;          // the price file, kept open between calls
+	long messageCount;
 };
 
 //template<typename T>
@@ -187,28 +289,50 @@ private:
 
 template<typename T>
 Price<T>::Price(const T &_product, double _mid, double _bidOfferSpread) :
+	product(&_product)
+{
+	midTicks = (int32_t)lround(_mid * TICKS_PER_POINT);
+	bidOfferSpreadTicks = (int32_t)lround(_bidOfferSpread * TICKS_PER_POINT);
+}
+
+template<typename T>
+Price<T>::Price(const T *_product, int32_t _midTicks, int32_t _bidOfferSpreadTicks) :
 	product(_product)
 {
-	mid = _mid;
-	bidOfferSpread = _bidOfferSpread;
+	assert(product != nullptr);
+	midTicks = _midTicks;
+	bidOfferSpreadTicks = _bidOfferSpreadTicks;
 }
 
 template<typename T>
 const T& Price<T>::GetProduct() const
 {
-	return product;
+	assert(product != nullptr);
+	return *product;
 }
 
 template<typename T>
 double Price<T>::GetMid() const
 {
-	return mid;
+	return (double)midTicks / TICKS_PER_POINT;
 }
 
 template<typename T>
 double Price<T>::GetBidOfferSpread() const
 {
-	return bidOfferSpread;
+	return (double)bidOfferSpreadTicks / TICKS_PER_POINT;
+}
+
+template<typename T>
+int32_t Price<T>::GetMidTicks() const
+{
+	return midTicks;
+}
+
+template<typename T>
+int32_t Price<T>::GetBidOfferSpreadTicks() const
+{
+	return bidOfferSpreadTicks;
 }
 
 #endif
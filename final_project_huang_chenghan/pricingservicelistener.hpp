@@ -9,6 +9,7 @@
 #include "algostreamingservice.hpp"
 #include "soa.hpp"
 #include "products.hpp"
+#include "pipeline.hpp"
 
 template<typename T>
 class PricingServiceListener : public ServiceListener<Price<T>>
@@ -22,8 +23,7 @@ public:
 
 	virtual void ProcessAdd(Price<T> &_product)
 	{
-		PriceStream<T> pricestream = algostream->ConvertToPriceStream(_product);
-		AlgoPriceStream<T> algopricestream(pricestream);
+		algostream->ConvertToPriceStream(_product);
 	}
 
 	virtual void ProcessRemove(Price<T> &data) {}
@@ -37,4 +37,27 @@ private:
 	}
 };
 
+/**
+* Static pipeline stage doing the work of PricingServiceListener: price -> algo stream.
+* Type T is the product type.
+*/
+template<typename T>
+class PricingStage : public PipelineStage
+{
+public:
+	PricingStage()
+	{
+		algostream = AlgoStreamingService<T>::Generate_Instance();
+	}
+
+	template<typename Next>
+	void Process(Price<T> &data, Next &next)
+	{
+		algostream->ConvertToPriceStream(data, next);
+	}
+
+private:
+	AlgoStreamingService<T>* algostream;
+};
+
 #endif
\ No newline at end of file
@@ -0,0 +1,207 @@
+/**
+* quoteskewservice.hpp
+* Skew and size two-way prices against the live position and PV01 of each product.
+*
+* @author Chenghan Huang
+*/
+#ifndef QUOTE_SKEW_SERVICE_HPP
+#define QUOTE_SKEW_SERVICE_HPP
+
+#include <string>
+#include <map>
+#include <deque>
+#include <mutex>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include "soa.hpp"
+#include "seqlock.hpp"
+#include "positionservice.hpp"
+#include "riskservice.hpp"
+
+using namespace std;
+
+/**
+* Skew parameters. Risk is aggregate position times PV01, i.e. dollars per basis point.
+* The quote is shifted against the risk by skewTicksPerRisk ticks per dollar, capped at
+* maxSkewTicks, and the side that would add to the risk is shrunk by
+* sizeReductionPerRisk per dollar, never below minSizeFraction of the unskewed size.
+*/
+struct SkewParameters
+{
+	double skewTicksPerRisk;
+	double maxSkewTicks;
+	double sizeReductionPerRisk;
+	double minSizeFraction;
+};
+
+/**
+* Cached position and PV01 of one product, as last seen by the skew service.
+*/
+struct QuoteRiskState
+{
+	long position;
+	double pv01;
+};
+
+/**
+* Quote skew service listening to the PositionService and RiskService.
+* Position and PV01 updates are cached per product in seqlock slots, so quoting threads
+* read them without locks; the parameters live in a seqlock too and can be reloaded at any time.
+* Type T is the product type.
+*/
+template<typename T>
+class QuoteSkewService : public ServiceListener<Position<T> >, public ServiceListener<PV01<T> >
+{
+public:
+	static QuoteSkewService<T>* Generate_Instance()
+	{
+		static QuoteSkewService<T> instance;
+		return &instance;
+	}
+
+	// Position update: cache the new aggregate position
+	virtual void ProcessAdd(Position<T> &data)
+	{
+		WriterSlot &writer = GetWriterSlot(data.GetProduct().GetProductId());
+		writer.state.position = data.GetAggregatePosition();
+		writer.slot->Store(writer.state);
+	}
+
+	// Risk update: cache the new PV01
+	virtual void ProcessAdd(PV01<T> &data)
+	{
+		WriterSlot &writer = GetWriterSlot(data.GetProduct().GetProductId());
+		writer.state.pv01 = data.GetPV01();
+		writer.slot->Store(writer.state);
+	}
+
+	virtual void ProcessRemove(Position<T> &data) {}
+	virtual void ProcessUpdate(Position<T> &data) {}
+	virtual void ProcessRemove(PV01<T> &data) {}
+	virtual void ProcessUpdate(PV01<T> &data) {}
+
+	// Get the risk slot of a product, creating it if needed. The slot lives as long as
+	// the service, so quoting threads look it up once per product and keep it.
+	const SeqLock<QuoteRiskState>* GetSlot(const string &id)
+	{
+		return AcquireSlot(id);
+	}
+
+	// Replace the skew parameters (single control thread)
+	void SetParameters(const SkewParameters &_parameters)
+	{
+		parameters.Store(_parameters);
+	}
+
+	// Get the current skew parameters
+	SkewParameters GetParameters() const
+	{
+		SkewParameters p;
+		parameters.Load(p);
+		return p;
+	}
+
+	// Reload the parameters from a file of name=value lines; unknown names are ignored
+	bool LoadParameters(const string &path)
+	{
+		ifstream is(path);
+		if (!is) return false;
+		SkewParameters p = GetParameters();
+		string line;
+		while (getline(is, line))
+		{
+			size_t idx = line.find('=');
+			if (idx == string::npos) continue;
+			string name = line.substr(0, idx);
+			double value = atof(line.substr(idx + 1).c_str());
+			if (name == "skewTicksPerRisk") p.skewTicksPerRisk = value;
+			else if (name == "maxSkewTicks") p.maxSkewTicks = value;
+			else if (name == "sizeReductionPerRisk") p.sizeReductionPerRisk = value;
+			else if (name == "minSizeFraction") p.minSizeFraction = value;
+		}
+		SetParameters(p);
+		return true;
+	}
+
+	// Skew a two-way price in place against the cached risk of its product
+	void Skew(const SeqLock<QuoteRiskState> *slot, double &bidPrice, double &offerPrice,
+		double &bidVisible, double &bidHidden, double &offerVisible, double &offerHidden) const
+	{
+		QuoteRiskState state;
+		if (slot->Load(state) == 0) return;
+		SkewParameters p;
+		parameters.Load(p);
+
+		double risk = state.position * state.pv01;
+		double skewTicks = -risk * p.skewTicksPerRisk;
+		if (skewTicks > p.maxSkewTicks) skewTicks = p.maxSkewTicks;
+		if (skewTicks < -p.maxSkewTicks) skewTicks = -p.maxSkewTicks;
+		double skew = round(skewTicks) / TICKS_PER_POINT;
+		bidPrice += skew;
+		offerPrice += skew;
+
+		double fraction = 1 - abs(risk) * p.sizeReductionPerRisk;
+		if (fraction < p.minSizeFraction) fraction = p.minSizeFraction;
+		if (risk > 0)
+		{
+			bidVisible = ceil(bidVisible * fraction);
+			bidHidden = ceil(bidHidden * fraction);
+		}
+		else if (risk < 0)
+		{
+			offerVisible = ceil(offerVisible * fraction);
+			offerHidden = ceil(offerHidden * fraction);
+		}
+	}
+
+private:
+	struct WriterSlot
+	{
+		SeqLock<QuoteRiskState>* slot;
+		QuoteRiskState state;
+	};
+
+	SeqLock<SkewParameters> parameters;
+	deque<SeqLock<QuoteRiskState>> RiskSlots;        // one slot per product, never moved
+	map<string, SeqLock<QuoteRiskState>*> SlotMap;   // guarded by slotMutex
+	map<string, WriterSlot> WriterMap;               // position/risk thread only
+	mutex slotMutex;
+
+	QuoteSkewService()
+	{
+		// one tick per $1000 PV01, at most a quarter of a 32nd; halve the size by $1000 PV01
+		SkewParameters p;
+		p.skewTicksPerRisk = 0.001;
+		p.maxSkewTicks = 2;
+		p.sizeReductionPerRisk = 0.0005;
+		p.minSizeFraction = 0.1;
+		SetParameters(p);
+	}
+
+	SeqLock<QuoteRiskState>* AcquireSlot(const string &id)
+	{
+		lock_guard<mutex> lock(slotMutex);
+		auto it = SlotMap.find(id);
+		if (it != SlotMap.end()) return it->second;
+		RiskSlots.emplace_back();
+		SlotMap.insert(pair<string, SeqLock<QuoteRiskState>*>(id, &RiskSlots.back()));
+		return &RiskSlots.back();
+	}
+
+	WriterSlot& GetWriterSlot(const string &id)
+	{
+		auto it = WriterMap.find(id);
+		if (it == WriterMap.end())
+		{
+			WriterSlot writer;
+			writer.slot = AcquireSlot(id);
+			writer.state.position = 0;
+			writer.state.pv01 = 0;
+			it = WriterMap.insert(pair<string, WriterSlot>(id, writer)).first;
+		}
+		return it->second;
+	}
+};
+
+#endif
@@ -0,0 +1,79 @@
+/**
+* randomgenerator.hpp
+* Fast seedable pseudo random number generator for the pricing and execution paths.
+*
+* @author Chenghan Huang
+*/
+#ifndef RANDOM_GENERATOR_HPP
+#define RANDOM_GENERATOR_HPP
+
+#include <cstdint>
+
+using namespace std;
+
+/**
+* xoshiro256** generator (Blackman & Vigna), seeded through splitmix64.
+* Not thread safe: give each thread its own instance. The same seed always
+* reproduces the same sequence, which lets a replay regenerate identical streams.
+*/
+class Xoshiro256
+{
+
+public:
+
+	// ctor for a generator
+	explicit Xoshiro256(uint64_t _seed = 0x5eed5eed5eed5eedULL)
+	{
+		Seed(_seed);
+	}
+
+	// Reset the state from a 64-bit seed
+	void Seed(uint64_t _seed)
+	{
+		uint64_t x = _seed;
+		for (int i = 0; i < 4; i++)
+		{
+			uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+			z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+			z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+			state[i] = z ^ (z >> 31);
+		}
+	}
+
+	// Get the next 64 random bits
+	uint64_t Next()
+	{
+		uint64_t result = Rotl(state[1] * 5, 7) * 9;
+		uint64_t t = state[1] << 17;
+		state[2] ^= state[0];
+		state[3] ^= state[1];
+		state[1] ^= state[2];
+		state[0] ^= state[3];
+		state[2] ^= t;
+		state[3] = Rotl(state[3], 45);
+		return result;
+	}
+
+	// Get a number in [0, bound) without a division (Lemire's multiply-shift)
+	uint32_t NextBounded(uint32_t bound)
+	{
+		return (uint32_t)(((Next() >> 32) * (uint64_t)bound) >> 32);
+	}
+
+	// Get a number in [0, 1)
+	double NextDouble()
+	{
+		return (Next() >> 11) * (1.0 / 9007199254740992.0);
+	}
+
+private:
+	uint64_t state[4];
+
+	static uint64_t Rotl(uint64_t x, int k)
+	{
+		return (x << k) | (x >> (64 - k));
+	}
+
+};
+
+#endif
@@ -9,8 +9,11 @@
 
 #include <vector>
 #include <iostream>
+#include <chrono>
 #include "soa.hpp"
 #include "positionservice.hpp"
+#include "snapshottable.hpp"
+#include "arena.hpp"
 //#include "products.hpp"
 
 template <typename T>
@@ -77,6 +80,11 @@ private:
  * Risk Service to vend out risk for a particular security and across a risk bucketed sector.
  * Keyed on product identifier.
  * Type T is the product type.
+ * In conflating mode updates are coalesced per product and only the latest PV01 of each
+ * product is published, once every maxUpdates updates or intervalMs milliseconds. The interval
+ * is checked on every update and on FlushExpired, which the owner calls on its ticks so the
+ * last updates before a quiet spell are not held until the next one.
+ * Every update also lands in a snapshot table that other threads read through TryGet.
  */
 template<typename T>
 class RiskService : public Service<string,PV01<T> >
@@ -84,6 +92,7 @@ class RiskService : public Service<string,PV01<T> >
 
 public:
 	map<string, PV01<T>> RiskMap;
+	map<string, PV01<T>, less<string>, PoolAllocator<pair<const string, PV01<T>>>> ConflatedMap;    // emptied on every flush, so pooled
 	vector<ServiceListener<PV01<T>>*> ListenerList;
 
 	// Add a position that the service will risk
@@ -112,7 +121,102 @@ public:
 		{
 			RiskMap[id] = pv01;
 		}
+		RiskSnapshots.Store(id, pv01);
 
+		updateCount++;
+		if (!conflate)
+		{
+			PushToListeners(pv01);
+			return;
+		}
+
+		ConflatedMap[id] = pv01;
+		pendingCount++;
+		if (pendingCount >= maxUpdates || std::chrono::steady_clock::now() - lastFlush >= std::chrono::milliseconds(intervalMs))
+		{
+			Flush();
+		}
+	}
+
+	// Risk a block of positions: the PV01 of a product is looked up and snapshotted once for
+	// each run of its positions. Conflation counts every update as AddPosition does, but the
+	// clock is read once, at the end of the block.
+	void AddPositionBatch(Position<T> *positions, size_t count)
+	{
+		BatchList.clear();
+		auto it = RiskMap.end();
+		for (size_t i = 0; i < count; i++)
+		{
+			const T &product = positions[i].GetProduct();
+			const string &id = product.GetProductId();
+			PV01<T> pv01(product, GetPV01(product), positions[i].GetAggregatePosition());
+			if (it == RiskMap.end() || it->first != id)
+			{
+				if (it != RiskMap.end()) RiskSnapshots.Store(it->first, it->second);
+				it = RiskMap.find(id);
+				if (it == RiskMap.end()) it = RiskMap.insert(pair<string, PV01<T>>(id, pv01)).first;
+			}
+			it->second = pv01;
+
+			updateCount++;
+			if (!conflate)
+			{
+				BatchList.push_back(pv01);
+				continue;
+			}
+			ConflatedMap[id] = pv01;
+			pendingCount++;
+			if (pendingCount >= maxUpdates) Flush();
+		}
+		if (it != RiskMap.end()) RiskSnapshots.Store(it->first, it->second);
+
+		if (!conflate)
+		{
+			if (BatchList.empty()) return;
+			publishCount += BatchList.size();
+			for (int i = 0; i < ListenerList.size(); i++)
+			{
+				ServiceListener<PV01<T>>* listener = ListenerList[i];
+				listener->ProcessAddBatch(BatchList.data(), BatchList.size());
+			}
+		}
+		else if (pendingCount > 0 && std::chrono::steady_clock::now() - lastFlush >= std::chrono::milliseconds(intervalMs))
+		{
+			Flush();
+		}
+	}
+
+	// Coalesce updates per product, publishing every _maxUpdates updates or _intervalMs milliseconds
+	void SetConflation(bool _conflate, long _maxUpdates, long _intervalMs)
+	{
+		if (conflate && !_conflate) Flush();
+		conflate = _conflate;
+		maxUpdates = (_maxUpdates > 0 ? _maxUpdates : 1);
+		intervalMs = _intervalMs;
+		lastFlush = std::chrono::steady_clock::now();
+	}
+
+	// Publish what is pending once intervalMs have passed since the last flush
+	void FlushExpired()
+	{
+		if (pendingCount > 0 && std::chrono::steady_clock::now() - lastFlush >= std::chrono::milliseconds(intervalMs)) Flush();
+	}
+
+	// Publish the latest PV01 of every product updated since the last flush
+	void Flush()
+	{
+		for (auto it = ConflatedMap.begin(); it != ConflatedMap.end(); it++)
+		{
+			PushToListeners(it->second);
+		}
+		ConflatedMap.clear();
+		pendingCount = 0;
+		lastFlush = std::chrono::steady_clock::now();
+	}
+
+	void PushToListeners(PV01<T> &pv01)
+	{
+		publishCount++;
 		for (int i = 0; i < ListenerList.size(); i++)
 		{
 			ServiceListener<PV01<T>>* listener = ListenerList[i];
@@ -120,11 +224,23 @@ public:
 		}
 	}
 
+	// Get the number of position updates received
+	long GetUpdateCount() const
+	{
+		return updateCount;
+	}
+
+	// Get the number of PV01 records published to listeners
+	long GetPublishCount() const
+	{
+		return publishCount;
+	}
+
 	void Add(PV01<T> pv01)
 	{
 		T product = pv01.GetProduct();
 		string id = product.GetProductId();
-		RiskMap.insert(pair<string, PV01<T>>(id, pv01));
+		if (RiskMap.insert(pair<string, PV01<T>>(id, pv01)).second) RiskSnapshots.Store(id, pv01);
 	}
 
 	// Get the bucketed risk for the bucket sector
@@ -141,7 +257,13 @@ public:
 
 	virtual PV01<T>& GetData(string _id)
 	{
-		return RiskMap[_id];
+		return RiskMap.at(_id);
+	}
+
+	// Copy out the latest PV01 of a product from any thread, conflated or not; false if it has none
+	bool TryGet(const string &_id, PV01<T> &pv01) const
+	{
+		return RiskSnapshots.TryGet(_id, pv01);
 	}
 
 	virtual void OnMessage(PV01<T> &data) {}
@@ -156,6 +278,28 @@ public:
 		return ListenerList;
 	}
 
+private:
+	SnapshotTable<string, PV01<T>> RiskSnapshots;
+	vector<PV01<T>> BatchList;    // PV01s of the batch being risked, reused
+	bool conflate;
+	long maxUpdates;
+	long intervalMs;
+	long pendingCount;
+	long updateCount;
+	long publishCount;
+	std::chrono::steady_clock::time_point lastFlush;
+
+	RiskService()
+	{
+		conflate = false;
+		maxUpdates = 1;
+		intervalMs = 0;
+		pendingCount = 0;
+		updateCount = 0;
+		publishCount = 0;
+		lastFlush = std::chrono::steady_clock::now();
+	}
+
 };
 
 template<typename T>
@@ -0,0 +1,453 @@
+/**
+* scenarioriskservice.hpp
+* Reprice the position set under parallel, twist and key-rate yield scenarios.
+*
+* @author Chenghan Huang
+*/
+#ifndef SCENARIO_RISK_SERVICE_HPP
+#define SCENARIO_RISK_SERVICE_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cmath>
+#include <iostream>
+#include "soa.hpp"
+#include "products.hpp"
+#include "positionservice.hpp"
+#include "pricingservice.hpp"
+
+using namespace std;
+
+// Shape of a yield curve shift
+enum ScenarioType { PARALLEL, TWIST, KEY_RATE };
+
+/**
+* A yield curve scenario. Shifts are in basis points, tenors in years.
+* PARALLEL moves every tenor by shortShift.
+* TWIST moves linearly from shortShift at lowerTenor to longShift at upperTenor, flat outside.
+* KEY_RATE is a triangular bump of shortShift at tenor, fading to zero at lowerTenor and upperTenor.
+*/
+class CurveScenario
+{
+
+public:
+
+	CurveScenario() {}
+
+	// ctor for a scenario
+	CurveScenario(string _name, ScenarioType _type, double _shortShift, double _longShift, double _tenor, double _lowerTenor, double _upperTenor)
+	{
+		name = _name;
+		type = _type;
+		shortShift = _shortShift;
+		longShift = _longShift;
+		tenor = _tenor;
+		lowerTenor = _lowerTenor;
+		upperTenor = _upperTenor;
+	}
+
+	// Get the name of the scenario
+	const string& GetName() const
+	{
+		return name;
+	}
+
+	// Get the scenario type
+	ScenarioType GetType() const
+	{
+		return type;
+	}
+
+	// Get the yield shift in decimal for a given tenor in years
+	double GetShift(double _tenor) const
+	{
+		double bp = 0;
+		switch (type) {
+		case PARALLEL:
+			bp = shortShift;
+			break;
+		case TWIST:
+			if (_tenor <= lowerTenor) bp = shortShift;
+			else if (_tenor >= upperTenor) bp = longShift;
+			else bp = shortShift + (longShift - shortShift) * (_tenor - lowerTenor) / (upperTenor - lowerTenor);
+			break;
+		case KEY_RATE:
+			if (_tenor <= lowerTenor || _tenor >= upperTenor) bp = 0;
+			else if (_tenor <= tenor) bp = (tenor == lowerTenor ? shortShift : shortShift * (_tenor - lowerTenor) / (tenor - lowerTenor));
+			else bp = (tenor == upperTenor ? shortShift : shortShift * (upperTenor - _tenor) / (upperTenor - tenor));
+			break;
+		}
+		return bp / 10000.;
+	}
+
+private:
+	string name;
+	ScenarioType type;
+	double shortShift;
+	double longShift;
+	double tenor;
+	double lowerTenor;
+	double upperTenor;
+
+};
+
+/**
+* Result of repricing the position set under one scenario.
+*/
+class ScenarioResult
+{
+
+public:
+
+	ScenarioResult() {}
+
+	// ctor for a scenario result
+	ScenarioResult(string _name, double _baseValue, double _pnl)
+	{
+		name = _name;
+		baseValue = _baseValue;
+		pnl = _pnl;
+	}
+
+	// Get the scenario name
+	const string& GetName() const
+	{
+		return name;
+	}
+
+	// Get the market value of the position set before the shift
+	double GetBaseValue() const
+	{
+		return baseValue;
+	}
+
+	// Get the change in market value under the scenario
+	double GetPnL() const
+	{
+		return pnl;
+	}
+
+private:
+	string name;
+	double baseValue;
+	double pnl;
+
+};
+
+/**
+* Scenario risk service repricing every position in the PositionService under a set of curve scenarios,
+* as of a valuation date the caller gives; positions maturing by then are left out and counted.
+* Base yields are implied from the PricingService mid, falling back to the coupon when no price is known.
+* Scenarios are spread over a pool of worker threads started on the first run and kept until the
+* service goes away; the calling thread works as worker 0. Each worker has its own scratch buffer
+* of shifted yields.
+* Keyed on scenario name.
+* Type T is the product type.
+*/
+template<typename T>
+class ScenarioRiskService : public Service<string, ScenarioResult>
+{
+public:
+	map<string, ScenarioResult> ResultMap;
+	vector<ServiceListener<ScenarioResult>*> ListenerList;
+
+	static ScenarioRiskService<T>* Generate_Instance()
+	{
+		static ScenarioRiskService<T> instance;
+		return &instance;
+	}
+
+	// Set the number of threads used by RunScenarios, the caller included; the pool is
+	// resized on the next run
+	void SetWorkerCount(int _workerCount)
+	{
+		workerCount = (_workerCount > 0 ? _workerCount : 1);
+	}
+
+	// Reprice the current position set as of _valuationDate under every scenario and publish the results
+	const vector<ScenarioResult>& RunScenarios(const vector<CurveScenario> &scenarios, const date &_valuationDate)
+	{
+		LoadPositions(_valuationDate);
+		results.assign(scenarios.size(), ScenarioResult());
+
+		int workers = workerCount;
+		if (workers > (int)scenarios.size()) workers = (int)scenarios.size();
+		if (workers < 1) workers = 1;
+		StartWorkers();
+
+		{
+			lock_guard<mutex> lock(poolMutex);
+			job = &scenarios;
+			jobWorkers = workers;
+			pending = (int)WorkerList.size();
+			generation++;
+		}
+		workReady.notify_all();
+		RunWorker(0, workers, scenarios);
+		{
+			unique_lock<mutex> lock(poolMutex);
+			workDone.wait(lock, [this] { return pending == 0; });
+			job = nullptr;
+		}
+
+		for (int i = 0; i < results.size(); i++)
+		{
+			ScenarioResult &result = results[i];
+			ResultMap[result.GetName()] = result;
+			for (int j = 0; j < ListenerList.size(); j++)
+			{
+				ServiceListener<ScenarioResult>* listener = ListenerList[j];
+				listener->ProcessAdd(result);
+			}
+		}
+		return results;
+	}
+
+	// A standard intraday set: parallel shifts, steepeners/flatteners and key-rate bumps
+	static vector<CurveScenario> StandardScenarios()
+	{
+		vector<CurveScenario> scenarios;
+		for (int bp = -100; bp <= 100; bp++)
+		{
+			if (bp == 0) continue;
+			scenarios.push_back(CurveScenario("PARALLEL " + std::to_string(bp) + "bp", PARALLEL, bp, bp, 0, 0, 0));
+		}
+		for (int bp = 5; bp <= 50; bp += 5)
+		{
+			scenarios.push_back(CurveScenario("STEEPEN 2s30s " + std::to_string(bp) + "bp", TWIST, -bp / 2., bp / 2., 0, 2, 30));
+			scenarios.push_back(CurveScenario("FLATTEN 2s30s " + std::to_string(bp) + "bp", TWIST, bp / 2., -bp / 2., 0, 2, 30));
+		}
+		double tenors[] = { 0, 0.5, 1, 2, 3, 5, 7, 10, 20, 30, 50 };
+		string labels[] = { "0", "6m", "1y", "2y", "3y", "5y", "7y", "10y", "20y", "30y", "50y" };
+		int count = sizeof(tenors) / sizeof(tenors[0]);
+		for (int i = 1; i < count - 1; i++)
+		{
+			for (int bp = -10; bp <= 10; bp += 20)
+			{
+				scenarios.push_back(CurveScenario("KEYRATE " + labels[i] + " " + std::to_string(bp) + "bp", KEY_RATE, bp, bp, tenors[i], tenors[i - 1], tenors[i + 1]));
+			}
+		}
+		return scenarios;
+	}
+
+	// Price per 100 face of a semi-annual bond given its yield, coupon and years to maturity
+	static double BondPrice(double yield, double coupon, double tenor)
+	{
+		if (tenor <= 0) return 0;
+		double discount = 1 + yield / 2;
+		int periods = (int)ceil(tenor * 2 - 1e-9);
+		double stub = tenor * 2 - (periods - 1);
+		double factor = pow(discount, -stub);
+		double price = 0;
+		for (int k = 0; k < periods; k++)
+		{
+			price += coupon * 50 * factor;
+			factor /= discount;
+		}
+		return price + 100 * pow(discount, -tenor * 2);
+	}
+
+	// Solve for the yield reproducing a price, starting the search from the coupon
+	static double BondYield(double price, double coupon, double tenor)
+	{
+		double yield = coupon;
+		for (int i = 0; i < 50; i++)
+		{
+			double p = BondPrice(yield, coupon, tenor);
+			double dp = (BondPrice(yield + 1e-6, coupon, tenor) - p) / 1e-6;
+			if (dp == 0) break;
+			double step = (p - price) / dp;
+			yield -= step;
+			if (abs(step) < 1e-12) break;
+		}
+		return yield;
+	}
+
+	// Get the number of positions repriced by the last run
+	size_t GetPositionCount() const
+	{
+		return tenors.size();
+	}
+
+	// Get the number of positions the last run left out as matured by the valuation date
+	size_t GetMaturedCount() const
+	{
+		return maturedCount;
+	}
+
+	virtual ScenarioResult& GetData(string _name)
+	{
+		return ResultMap.at(_name);
+	}
+
+	virtual void OnMessage(ScenarioResult &data) {}
+
+	virtual void AddListener(ServiceListener<ScenarioResult>* _listener)
+	{
+		ListenerList.push_back(_listener);
+	}
+
+	virtual const vector<ServiceListener<ScenarioResult>*>& GetListeners() const
+	{
+		return ListenerList;
+	}
+
+private:
+	PositionService<T>* _bondPositionService;
+	PricingService<T>* _bondPricingService;
+	int workerCount;
+	size_t maturedCount;
+
+	// flattened position set, shared read-only by the workers
+	vector<double> tenors;
+	vector<double> coupons;
+	vector<double> yields;
+	vector<double> quantities;
+	vector<double> basePrices;
+	double baseValue;
+
+	vector<vector<double> > scratch;     // shifted yields, one buffer per worker
+	vector<ScenarioResult> results;
+
+	// worker pool: threads 1..n-1 wait for a new generation of work, the caller is worker 0
+	vector<thread> WorkerList;
+	mutex poolMutex;
+	condition_variable workReady;
+	condition_variable workDone;
+	uint64_t generation;                      // bumped for every run
+	const vector<CurveScenario> *job;         // scenarios of the current run
+	int jobWorkers;                           // workers sharing the current run
+	int pending;                              // pool threads yet to finish the current run
+	bool stopping;
+
+	ScenarioRiskService()
+	{
+		_bondPositionService = PositionService<T>::Generate_Instance();
+		_bondPricingService = PricingService<T>::Generate_Instance();
+		workerCount = thread::hardware_concurrency();
+		if (workerCount < 1) workerCount = 1;
+		maturedCount = 0;
+		generation = 0;
+		job = nullptr;
+		jobWorkers = 0;
+		pending = 0;
+		stopping = false;
+	}
+
+	~ScenarioRiskService()
+	{
+		StopWorkers();
+	}
+
+	// Start the pool threads if there are not workerCount - 1 of them already
+	void StartWorkers()
+	{
+		if ((int)scratch.size() < workerCount) scratch.resize(workerCount);
+		if ((int)WorkerList.size() == workerCount - 1) return;
+		StopWorkers();
+		lock_guard<mutex> lock(poolMutex);
+		for (int w = 1; w < workerCount; w++)
+		{
+			WorkerList.push_back(thread(&ScenarioRiskService<T>::WorkerLoop, this, w, generation));
+		}
+	}
+
+	void StopWorkers()
+	{
+		{
+			lock_guard<mutex> lock(poolMutex);
+			stopping = true;
+		}
+		workReady.notify_all();
+		for (int w = 0; w < WorkerList.size(); w++)
+		{
+			WorkerList[w].join();
+		}
+		WorkerList.clear();
+		stopping = false;
+	}
+
+	// Pool thread: wait for each run, do this worker's share of it if it has one, report back
+	void WorkerLoop(int worker, uint64_t seen)
+	{
+		unique_lock<mutex> lock(poolMutex);
+		for (;;)
+		{
+			workReady.wait(lock, [this, seen] { return stopping || generation != seen; });
+			if (stopping) return;
+			seen = generation;
+			if (worker < jobWorkers)
+			{
+				const vector<CurveScenario> &scenarios = *job;
+				int workers = jobWorkers;
+				lock.unlock();
+				RunWorker(worker, workers, scenarios);
+				lock.lock();
+			}
+			if (--pending == 0) workDone.notify_one();
+		}
+	}
+
+	// Snapshot positions and base yields as of valuationDate into flat arrays
+	void LoadPositions(const date &valuationDate)
+	{
+		tenors.clear(); coupons.clear(); yields.clear(); quantities.clear(); basePrices.clear();
+		baseValue = 0;
+		maturedCount = 0;
+		for (auto it = _bondPositionService->PositionMap.begin(); it != _bondPositionService->PositionMap.end(); it++)
+		{
+			const T &product = it->second.GetProduct();
+			long quantity = it->second.GetAggregatePosition();
+			if (quantity == 0) continue;
+			double tenor = (product.GetMaturityDate() - valuationDate).days() / 365.;
+			if (tenor <= 0)
+			{
+				maturedCount++;
+				continue;
+			}
+
+			double coupon = product.GetCoupon();
+			double yield = coupon;
+			auto price = _bondPricingService->PriceMap.find(it->first);
+			if (price != _bondPricingService->PriceMap.end())
+			{
+				yield = BondYield(price->second.GetMid(), coupon, tenor);
+			}
+			double basePrice = BondPrice(yield, coupon, tenor);
+
+			tenors.push_back(tenor);
+			coupons.push_back(coupon);
+			yields.push_back(yield);
+			quantities.push_back(quantity);
+			basePrices.push_back(basePrice);
+			baseValue += quantity * basePrice / 100;
+		}
+	}
+
+	// Reprice every worker-th scenario starting at index worker
+	void RunWorker(int worker, int workers, const vector<CurveScenario> &scenarios)
+	{
+		vector<double> &shifted = scratch[worker];
+		shifted.resize(tenors.size());
+		for (int s = worker; s < scenarios.size(); s += workers)
+		{
+			const CurveScenario &scenario = scenarios[s];
+			for (int i = 0; i < tenors.size(); i++)
+			{
+				shifted[i] = yields[i] + scenario.GetShift(tenors[i]);
+			}
+			double pnl = 0;
+			for (int i = 0; i < tenors.size(); i++)
+			{
+				pnl += quantities[i] * (BondPrice(shifted[i], coupons[i], tenors[i]) - basePrices[i]) / 100;
+			}
+			results[s] = ScenarioResult(scenario.GetName(), baseValue, pnl);
+		}
+	}
+};
+
+#endif
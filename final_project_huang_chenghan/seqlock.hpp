@@ -0,0 +1,84 @@
+/**
+* seqlock.hpp
+* Single-writer sequence lock for publishing trivially copyable values to reader threads.
+*
+* @author Chenghan Huang
+*/
+#ifndef SEQLOCK_HPP
+#define SEQLOCK_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+using namespace std;
+
+/**
+* A latest-value slot guarded by a sequence counter.
+* One writer overwrites the value in place without ever blocking; readers on any thread
+* copy it out and retry if a write overlapped the copy. The value is held as atomic
+* words so a torn read is detected rather than being a data race.
+* Type V is the value type and must be trivially copyable.
+*/
+template<typename V>
+class SeqLock
+{
+	static_assert(std::is_trivially_copyable<V>::value, "SeqLock values must be trivially copyable");
+
+public:
+
+	SeqLock() : sequence(0)
+	{
+		for (int i = 0; i < WORDS; i++) words[i].store(0, memory_order_relaxed);
+	}
+
+	// Overwrite the value (single writer only)
+	void Store(const V &value)
+	{
+		uint64_t buffer[WORDS] = {};
+		memcpy(buffer, &value, sizeof(V));
+
+		uint64_t seq = sequence.load(memory_order_relaxed);
+		sequence.store(seq + 1, memory_order_relaxed);
+		atomic_thread_fence(memory_order_release);
+		for (int i = 0; i < WORDS; i++) words[i].store(buffer[i], memory_order_relaxed);
+		sequence.store(seq + 2, memory_order_release);
+	}
+
+	// Copy out a consistent value, returning its version (0 if never written)
+	uint64_t Load(V &value) const
+	{
+		uint64_t buffer[WORDS];
+		for (;;)
+		{
+			uint64_t before = sequence.load(memory_order_acquire);
+			if (before & 1) continue;
+			for (int i = 0; i < WORDS; i++) buffer[i] = words[i].load(memory_order_relaxed);
+			atomic_thread_fence(memory_order_acquire);
+			if (sequence.load(memory_order_relaxed) == before)
+			{
+				memcpy(&value, buffer, sizeof(V));
+				return before / 2;
+			}
+		}
+	}
+
+	// Get the number of writes so far
+	uint64_t GetVersion() const
+	{
+		return sequence.load(memory_order_acquire) / 2;
+	}
+
+private:
+	static const int WORDS = (sizeof(V) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+	atomic<uint64_t> sequence;
+	atomic<uint64_t> words[WORDS];
+
+	SeqLock(const SeqLock&);
+	SeqLock& operator=(const SeqLock&);
+
+};
+
+#endif
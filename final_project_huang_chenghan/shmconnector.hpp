@@ -0,0 +1,243 @@
+/**
+* shmconnector.hpp
+* Connectors moving service data between processes on one host through shared-memory rings.
+*
+* @author Chenghan Huang
+*/
+#ifndef SHM_CONNECTOR_HPP
+#define SHM_CONNECTOR_HPP
+
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include "soa.hpp"
+#include "products.hpp"
+#include "shmring.hpp"
+#include "pricingservice.hpp"
+#include "executionservice.hpp"
+#include "riskservice.hpp"
+
+using namespace std;
+
+// Copy a product identifier into a fixed-size, NUL terminated field
+template<size_t N>
+void CopyProductId(char (&field)[N], const string &id)
+{
+	memset(field, 0, N);
+	memcpy(field, id.data(), id.size() < N - 1 ? id.size() : N - 1);
+}
+
+/**
+* Fixed-size shared-memory record of a data type, with its encoding.
+* Records name the product by identifier since the product objects are per process;
+* decoding looks the product up in the receiving process's BondProductService.
+* Specialized for every type that can cross a process boundary.
+*/
+template<typename V>
+struct ShmRecord;
+
+template<>
+struct ShmRecord<Price<Bond> >
+{
+	char productId[16];
+	int32_t midTicks;
+	int32_t bidOfferSpreadTicks;
+
+	void Encode(const Price<Bond> &data)
+	{
+		CopyProductId(productId, data.GetProduct().GetProductId());
+		midTicks = data.GetMidTicks();
+		bidOfferSpreadTicks = data.GetBidOfferSpreadTicks();
+	}
+
+	Price<Bond> Decode(BondProductService *productService) const
+	{
+		return Price<Bond>(&productService->GetData(string(productId)), midTicks, bidOfferSpreadTicks);
+	}
+};
+
+template<>
+struct ShmRecord<PV01<Bond> >
+{
+	char productId[16];
+	double pv01;
+	int64_t quantity;
+
+	void Encode(const PV01<Bond> &data)
+	{
+		CopyProductId(productId, data.GetProduct().GetProductId());
+		pv01 = data.GetPV01();
+		quantity = data.GetQuantity();
+	}
+
+	PV01<Bond> Decode(BondProductService *productService) const
+	{
+		return PV01<Bond>(productService->GetData(string(productId)), pv01, quantity);
+	}
+};
+
+template<>
+struct ShmRecord<ExecutionOrder<Bond> >
+{
+	char productId[16];
+	uint64_t orderId;
+	uint64_t parentOrderId;
+	int32_t side;
+	int32_t orderType;
+	double price;
+	int64_t visibleQuantity;
+	int64_t hiddenQuantity;
+	int32_t isChildOrder;
+
+	void Encode(const ExecutionOrder<Bond> &data)
+	{
+		CopyProductId(productId, data.GetProduct().GetProductId());
+		orderId = data.GetOrderId();
+		parentOrderId = data.GetParentOrderId();
+		side = data.GetSide();
+		orderType = data.GetOrderType();
+		price = data.GetPrice();
+		visibleQuantity = data.GetVisibleQuantity();
+		hiddenQuantity = data.GetHiddenQuantity();
+		isChildOrder = data.IsChildOrder();
+	}
+
+	ExecutionOrder<Bond> Decode(BondProductService *productService) const
+	{
+		return ExecutionOrder<Bond>(productService->GetData(string(productId)), (PricingSide)side, orderId, (OrderType)orderType,
+			price, visibleQuantity, hiddenQuantity, parentOrderId, isChildOrder != 0);
+	}
+};
+
+/**
+* Publisher connector writing a service's data into a shared-memory ring.
+* The record is encoded in place in the ring slot; nothing is copied afterwards.
+* Type V is the data type.
+*/
+template<typename V>
+class ShmPublisherConnector : public Connector<V>
+{
+public:
+
+	// ctor for a publisher creating the ring name with room for capacity records
+	ShmPublisherConnector(const string &name, uint64_t capacity) : ring(name, capacity, true) {}
+
+	void Publish(V &data)
+	{
+		ring.Claim()->Encode(data);
+		ring.Commit();
+	}
+
+	void Subscribe() {}  // implement nothing, publish-only
+
+private:
+	ShmRing<ShmRecord<V> > ring;
+};
+
+/**
+* Subscriber connector reading a shared-memory ring and calling a service's OnMessage.
+* Every subscriber has its own cursor, so several processes can read one ring at their own pace;
+* records overwritten before a slow subscriber reached them are counted in GetLost().
+* Type V is the data type.
+*/
+template<typename V>
+class ShmSubscriberConnector : public Connector<V>
+{
+public:
+
+	// ctor for a subscriber to the ring name, delivering to service
+	ShmSubscriberConnector(const string &name, Service<string, V> *_service) :
+		ring(name, 0, false), reader(ring)
+	{
+		service = _service;
+		productService = BondProductService::Generate_Instance();
+	}
+
+	void Publish(V &data) {}  // implement nothing, subscribe-only
+
+	// Deliver every record published so far to the service
+	void Subscribe()
+	{
+		while (Poll(1024) > 0) {}
+	}
+
+	// Deliver up to maxRecords records to the service; returns how many were delivered.
+	// Records are decoded in place; one the writer overwrote meanwhile decodes torn and is
+	// dropped, counted as lost.
+	int Poll(int maxRecords)
+	{
+		int count = 0;
+		while (count < maxRecords)
+		{
+			const ShmRecord<V> *record = reader.Peek();
+			if (record == nullptr) break;
+			V data = record->Decode(productService);
+			if (!reader.Release()) continue;
+			service->OnMessage(data);
+			count++;
+		}
+		return count;
+	}
+
+	// Hand records to read(const ShmRecord<V>&) in the ring, without copying or decoding them,
+	// and what read returns to use; returns how many were used. The slot is checked after read
+	// returns: if the writer overwrote it meanwhile, the result is dropped, counted as lost.
+	template<typename Read, typename Use>
+	int Consume(Read read, Use use, int maxRecords)
+	{
+		int count = 0;
+		while (count < maxRecords)
+		{
+			const ShmRecord<V> *record = reader.Peek();
+			if (record == nullptr) break;
+			auto result = read(*record);
+			if (!reader.Release()) continue;
+			use(result);
+			count++;
+		}
+		return count;
+	}
+
+	// Get the number of records overwritten before this subscriber read them
+	uint64_t GetLost() const
+	{
+		return reader.GetLost();
+	}
+
+private:
+	ShmRing<ShmRecord<V> > ring;
+	ShmRingReader<ShmRecord<V> > reader;
+	Service<string, V> *service;
+	BondProductService *productService;
+};
+
+/**
+* Listener forwarding a service's add events to a connector, e.g. to publish a service's
+* output into a shared-memory ring for another process.
+* Type V is the data type.
+*/
+template<typename V>
+class ConnectorServiceListener : public ServiceListener<V>
+{
+public:
+
+	// ctor for a listener publishing to _connector
+	explicit ConnectorServiceListener(Connector<V> *_connector)
+	{
+		connector = _connector;
+	}
+
+	void ProcessAdd(V &data)
+	{
+		connector->Publish(data);
+	}
+
+	void ProcessRemove(V &data) {}
+	void ProcessUpdate(V &data) {}
+
+private:
+	Connector<V> *connector;
+};
+
+#endif
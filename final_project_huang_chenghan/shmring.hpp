@@ -0,0 +1,251 @@
+/**
+* shmring.hpp
+* Single-producer multi-consumer ring buffer of fixed-size records in shared memory.
+*
+* @author Chenghan Huang
+*/
+#ifndef SHM_RING_HPP
+#define SHM_RING_HPP
+
+#include <string>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+/**
+* Ring of fixed-size records mapped from a POSIX shared memory object, or from anonymous
+* memory when the name is empty (same-process consumers).
+* The single writer never waits: it overwrites the oldest record, and every slot carries
+* the sequence number it holds so readers at any speed detect that they were lapped.
+* Readers consume records in place, without copying them out.
+* Type V is the record type and must be trivially copyable.
+*/
+template<typename V>
+class ShmRing
+{
+	static_assert(std::is_trivially_copyable<V>::value, "ShmRing records must be trivially copyable");
+
+public:
+
+	// Create (writer) or open (reader) a ring; capacity is rounded up to a power of two
+	ShmRing(const string &_name, uint64_t _capacity, bool _create)
+	{
+		name = _name;
+		owner = _create;
+		uint64_t capacity = 1;
+		while (capacity < _capacity) capacity <<= 1;
+
+		int fd = -1;
+		if (!name.empty())
+		{
+			fd = shm_open(name.c_str(), _create ? (O_CREAT | O_RDWR) : O_RDWR, 0666);
+			if (fd < 0) throw runtime_error("shm_open failed for " + name);
+			if (!_create)
+			{
+				uint64_t prefix[2];   // magic and capacity
+				if (read(fd, prefix, sizeof(prefix)) != sizeof(prefix) || prefix[0] != MAGIC)
+				{
+					close(fd);
+					throw runtime_error("not a ring: " + name);
+				}
+				capacity = prefix[1];
+			}
+		}
+
+		size = sizeof(Header) + capacity * sizeof(Slot);
+		if (fd >= 0 && _create && ftruncate(fd, size) != 0)
+		{
+			close(fd);
+			throw runtime_error("ftruncate failed for " + name);
+		}
+		void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, fd >= 0 ? MAP_SHARED : (MAP_SHARED | MAP_ANONYMOUS), fd, 0);
+		if (fd >= 0) close(fd);
+		if (memory == MAP_FAILED) throw runtime_error("mmap failed for " + name);
+
+		header = static_cast<Header*>(memory);
+		slots = reinterpret_cast<Slot*>(static_cast<char*>(memory) + sizeof(Header));
+		if (_create)
+		{
+			header->capacity = capacity;
+			header->writeSequence.store(0, memory_order_relaxed);
+			for (uint64_t i = 0; i < capacity; i++) slots[i].sequence.store(0, memory_order_relaxed);
+			header->magic = MAGIC;
+			atomic_thread_fence(memory_order_release);
+		}
+		mask = header->capacity - 1;
+	}
+
+	~ShmRing()
+	{
+		munmap(header, size);
+		if (owner && !name.empty()) shm_unlink(name.c_str());
+	}
+
+	// Get a slot to build the next record in place (writer only)
+	V* Claim()
+	{
+		uint64_t sequence = header->writeSequence.load(memory_order_relaxed);
+		Slot &slot = slots[sequence & mask];
+		slot.sequence.store(2 * sequence + 1, memory_order_relaxed);
+		atomic_thread_fence(memory_order_release);
+		return &slot.data;
+	}
+
+	// Make the claimed record visible to readers (writer only); returns its sequence number
+	uint64_t Commit()
+	{
+		uint64_t sequence = header->writeSequence.load(memory_order_relaxed);
+		slots[sequence & mask].sequence.store(2 * sequence + 2, memory_order_release);
+		header->writeSequence.store(sequence + 1, memory_order_release);
+		return sequence;
+	}
+
+	// Copy a record into the ring (writer only); returns its sequence number
+	uint64_t Publish(const V &data)
+	{
+		memcpy(Claim(), &data, sizeof(V));
+		return Commit();
+	}
+
+	// Get the sequence number the next record will be written with
+	uint64_t GetWriteSequence() const
+	{
+		return header->writeSequence.load(memory_order_acquire);
+	}
+
+	// Get the number of slots
+	uint64_t GetCapacity() const
+	{
+		return header->capacity;
+	}
+
+	// Look at the record with a given sequence number in place.
+	// Returns nullptr if it is not written yet; sets lapped if it was already overwritten.
+	const V* Peek(uint64_t sequence, bool &lapped) const
+	{
+		const Slot &slot = slots[sequence & mask];
+		uint64_t marker = slot.sequence.load(memory_order_acquire);
+		lapped = (marker > 2 * sequence + 2);
+		return (marker == 2 * sequence + 2 ? &slot.data : nullptr);
+	}
+
+	// After reading a peeked record, check that the writer did not overwrite it meanwhile
+	bool Validate(uint64_t sequence) const
+	{
+		atomic_thread_fence(memory_order_acquire);
+		return slots[sequence & mask].sequence.load(memory_order_relaxed) == 2 * sequence + 2;
+	}
+
+private:
+	static const uint64_t MAGIC = 0x53484d52494e4731ULL;
+
+	struct Header
+	{
+		uint64_t magic;
+		uint64_t capacity;
+		alignas(64) atomic<uint64_t> writeSequence;
+	};
+
+	struct alignas(64) Slot
+	{
+		atomic<uint64_t> sequence;   // 2n+1 while record n is written, 2n+2 once it is readable
+		V data;
+	};
+
+	string name;
+	bool owner;
+	size_t size;
+	uint64_t mask;
+	Header *header;
+	Slot *slots;
+
+	ShmRing(const ShmRing&);
+	ShmRing& operator=(const ShmRing&);
+
+};
+
+/**
+* One consumer's cursor into a ShmRing. Each reader advances at its own pace; a reader that
+* falls more than a ring behind skips forward to the oldest record still held and counts the loss.
+* Type V is the record type.
+*/
+template<typename V>
+class ShmRingReader
+{
+
+public:
+
+	// ctor for a reader starting at the oldest record still in the ring
+	explicit ShmRingReader(const ShmRing<V> &_ring) : ring(_ring)
+	{
+		uint64_t written = ring.GetWriteSequence();
+		next = (written > ring.GetCapacity() ? written - ring.GetCapacity() : 0);
+		lost = 0;
+	}
+
+	// Get the next record in place, or nullptr if the reader has caught up with the writer.
+	// Call Release() once done with it.
+	const V* Peek()
+	{
+		for (;;)
+		{
+			bool lapped;
+			const V* data = ring.Peek(next, lapped);
+			if (!lapped) return data;
+			Resync();
+		}
+	}
+
+	// Finish with the peeked record; false if it was overwritten while being read
+	bool Release()
+	{
+		bool valid = ring.Validate(next);
+		if (valid) next++;
+		else Resync();
+		return valid;
+	}
+
+	// Get the sequence number of the next record to read
+	uint64_t GetSequence() const
+	{
+		return next;
+	}
+
+	// Get the number of records overwritten before this reader got to them
+	uint64_t GetLost() const
+	{
+		return lost;
+	}
+
+private:
+	const ShmRing<V> &ring;
+	uint64_t next;
+	uint64_t lost;
+
+	void Resync()
+	{
+		uint64_t written = ring.GetWriteSequence();
+		uint64_t oldest = (written > ring.GetCapacity() ? written - ring.GetCapacity() : 0);
+		if (oldest > next)
+		{
+			lost += oldest - next;
+			next = oldest;
+		}
+		else
+		{
+			lost++;
+			next++;
+		}
+	}
+
+};
+
+#endif
@@ -0,0 +1,249 @@
+/**
+* smartorderrouter.hpp
+* Split orders across the BROKERTEC, ESPEED and CME venues at the lowest expected cost.
+*
+* @author Chenghan Huang
+*/
+#ifndef SMART_ORDER_ROUTER_HPP
+#define SMART_ORDER_ROUTER_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include "soa.hpp"
+#include "products.hpp"
+#include "marketdataservice.hpp"
+#include "executionservice.hpp"
+
+using namespace std;
+
+/**
+* Cost model of one venue: fee in ticks per unit, and the time in microseconds an order
+* takes to reach the venue, during which the displayed depth may trade away.
+*/
+struct VenueModel
+{
+	double feeTicks;
+	double latencyMicros;
+};
+
+/**
+* One slice of a routed order: quantity to send to venue, the worst price it may trade at,
+* and its expected cost per unit in ticks.
+*/
+struct RouteSlice
+{
+	Market venue;
+	long quantity;
+	int32_t limitTicks;
+	double expectedCostTicks;
+};
+
+/**
+* Smart order router over the consolidated depth of the three venues.
+* Every displayed level that the order may trade with is costed per unit as
+*   price + fee + latency * adverseTicksPerMicro + (1 - fillProbability) * missPenaltyTicks
+* (sign-flipped price for sells), where fillProbability = exp(-latency / depthLifetimeMicros)
+* is the chance the level is still there when the order arrives. Levels are taken cheapest
+* first and merged into at most one slice per venue; quantity beyond the displayed depth goes
+* to the venue with the cheapest touch, or to the default venue when no depth is known.
+* The depth taken is removed, so orders routed before the next book update do not chase it.
+* Type T is the product type.
+*/
+template<typename T>
+class SmartOrderRouter
+{
+public:
+	static SmartOrderRouter<T>* Generate_Instance()
+	{
+		static SmartOrderRouter<T> instance;
+		return &instance;
+	}
+
+	// Set the cost model of a venue
+	void SetVenueModel(Market _venue, const VenueModel &_model)
+	{
+		models[_venue] = _model;
+	}
+
+	// Get the cost model of a venue
+	const VenueModel& GetVenueModel(Market _venue) const
+	{
+		return models[_venue];
+	}
+
+	// Set the cost of latency, the lifetime of displayed depth and the penalty for a missed fill
+	void SetCostParameters(double _adverseTicksPerMicro, double _depthLifetimeMicros, double _missPenaltyTicks)
+	{
+		adverseTicksPerMicro = _adverseTicksPerMicro;
+		depthLifetimeMicros = _depthLifetimeMicros;
+		missPenaltyTicks = _missPenaltyTicks;
+	}
+
+	// Set the venue for orders on products without known depth
+	void SetDefaultVenue(Market _venue)
+	{
+		defaultVenue = _venue;
+	}
+
+	// Replace the depth of a product on a venue with an order book from it, or with _share of
+	// every level of a consolidated book
+	void UpdateDepth(Market _venue, const OrderBook<T> &_orderbook, double _share = 1)
+	{
+		VenueDepth &depth = DepthMap[_orderbook.GetProduct().GetProductId()].venues[_venue];
+		Load(_orderbook.GetBidStack(), _share, depth.bids);
+		Load(_orderbook.GetOfferStack(), _share, depth.offers);
+	}
+
+	// Route an order; the slices stay valid until the next call
+	const vector<RouteSlice>& Route(const ExecutionOrder<T> &_order)
+	{
+		SliceList.clear();
+		long quantity = _order.GetVisibleQuantity();
+		PricingSide side = _order.GetSide();
+		bool anyPrice = (_order.GetOrderType() == MARKET);
+		int32_t limitTicks = (int32_t)lround(_order.GetPrice() * TICKS_PER_POINT);
+		if (quantity <= 0) return SliceList;
+
+		auto it = DepthMap.find(_order.GetProduct().GetProductId());
+		if (it == DepthMap.end())
+		{
+			AddSlice(defaultVenue, quantity, limitTicks, 0);
+			return SliceList;
+		}
+
+		// cost every level the order may trade with, on the side it trades against
+		CandidateList.clear();
+		for (int v = 0; v < 3; v++)
+		{
+			vector<DepthLevel> &levels = (side == BID ? it->second.venues[v].offers : it->second.venues[v].bids);
+			double venueCost = VenueCost((Market)v);
+			for (int i = 0; i < levels.size(); i++)
+			{
+				if (levels[i].quantity <= 0) continue;
+				if (!anyPrice && (side == BID ? levels[i].priceTicks > limitTicks : levels[i].priceTicks < limitTicks)) continue;
+				Candidate candidate;
+				candidate.cost = (side == BID ? levels[i].priceTicks : -levels[i].priceTicks) + venueCost;
+				candidate.venue = (Market)v;
+				candidate.level = &levels[i];
+				CandidateList.push_back(candidate);
+			}
+		}
+		sort(CandidateList.begin(), CandidateList.end());
+
+		long slices[3] = { 0, 0, 0 };
+		int32_t worst[3] = { 0, 0, 0 };
+		double cost[3] = { 0, 0, 0 };
+		long unsent = quantity;
+		for (int i = 0; i < CandidateList.size() && unsent > 0; i++)
+		{
+			Candidate &candidate = CandidateList[i];
+			long take = (candidate.level->quantity < unsent ? candidate.level->quantity : unsent);
+			candidate.level->quantity -= take;
+			unsent -= take;
+			slices[candidate.venue] += take;
+			worst[candidate.venue] = candidate.level->priceTicks;
+			cost[candidate.venue] += take * candidate.cost;
+		}
+		if (unsent > 0)
+		{
+			// no more displayed depth: send the rest where the first unit was cheapest
+			Market venue = (CandidateList.empty() ? defaultVenue : CandidateList[0].venue);
+			slices[venue] += unsent;
+			worst[venue] = limitTicks;
+			cost[venue] += unsent * (CandidateList.empty() ? 0 : CandidateList[0].cost);
+		}
+		for (int v = 0; v < 3; v++)
+		{
+			if (slices[v] > 0) AddSlice((Market)v, slices[v], worst[v], cost[v] / slices[v]);
+		}
+		return SliceList;
+	}
+
+private:
+	struct DepthLevel
+	{
+		int32_t priceTicks;
+		long quantity;
+	};
+
+	struct VenueDepth
+	{
+		vector<DepthLevel> bids;
+		vector<DepthLevel> offers;
+	};
+
+	struct ProductDepth
+	{
+		VenueDepth venues[3];    // per Market
+	};
+
+	struct Candidate
+	{
+		double cost;
+		Market venue;
+		DepthLevel *level;
+
+		bool operator < (const Candidate &other) const
+		{
+			return cost < other.cost;
+		}
+	};
+
+	VenueModel models[3];
+	double adverseTicksPerMicro;
+	double depthLifetimeMicros;
+	double missPenaltyTicks;
+	Market defaultVenue;
+	map<string, ProductDepth> DepthMap;
+	vector<Candidate> CandidateList;    // scratch, reused across orders
+	vector<RouteSlice> SliceList;
+
+	SmartOrderRouter()
+	{
+		// BrokerTec and eSpeed are the cash venues, CME is further away but cheaper
+		VenueModel brokertec = { 0.02, 40 };
+		VenueModel espeed = { 0.03, 60 };
+		VenueModel cme = { 0.01, 120 };
+		models[BROKERTEC] = brokertec;
+		models[ESPEED] = espeed;
+		models[CME] = cme;
+		adverseTicksPerMicro = 0.0005;
+		depthLifetimeMicros = 2000;
+		missPenaltyTicks = 1;
+		defaultVenue = CME;
+	}
+
+	// Per-unit cost of trading on a venue on top of the price
+	double VenueCost(Market venue) const
+	{
+		const VenueModel &model = models[venue];
+		double fillProbability = exp(-model.latencyMicros / depthLifetimeMicros);
+		return model.feeTicks + model.latencyMicros * adverseTicksPerMicro + (1 - fillProbability) * missPenaltyTicks;
+	}
+
+	static void Load(const vector<Order> &stack, double share, vector<DepthLevel> &levels)
+	{
+		levels.resize(stack.size());
+		for (int i = 0; i < stack.size(); i++)
+		{
+			levels[i].priceTicks = (int32_t)lround(stack[i].GetPrice() * TICKS_PER_POINT);
+			levels[i].quantity = llround(stack[i].GetQuantity() * share);
+		}
+	}
+
+	void AddSlice(Market venue, long quantity, int32_t limitTicks, double expectedCostTicks)
+	{
+		RouteSlice slice;
+		slice.venue = venue;
+		slice.quantity = quantity;
+		slice.limitTicks = limitTicks;
+		slice.expectedCostTicks = expectedCostTicks;
+		SliceList.push_back(slice);
+	}
+};
+
+#endif
@@ -0,0 +1,201 @@
+/**
+* snapshottable.hpp
+* Latest-value tables that reader threads copy consistent snapshots out of without locks.
+*
+* @author Chenghan Huang
+*/
+#ifndef SNAPSHOT_TABLE_HPP
+#define SNAPSHOT_TABLE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <vector>
+#include <type_traits>
+#include "seqlock.hpp"
+
+using namespace std;
+
+/**
+* A latest-value slot for values that are not trivially copyable, in read-copy-update style.
+* The writer fills a spare copy of the value and swaps it in with one atomic exchange; readers
+* copy out whichever value is current. Replaced values are reused only once no reader is
+* inside Load, which readers announce on a counter, so the writer never waits on a reader.
+* Type V is the value type.
+*/
+template<typename V>
+class SnapshotCell
+{
+
+public:
+
+	SnapshotCell() : current(nullptr), readers(0), version(0), nodeCount(0) {}
+
+	~SnapshotCell()
+	{
+		delete current.load();
+		for (size_t i = 0; i < RetiredList.size(); i++) delete RetiredList[i];
+		for (size_t i = 0; i < SpareList.size(); i++) delete SpareList[i];
+	}
+
+	// Overwrite the value (single writer only)
+	void Store(const V &value)
+	{
+		Node *node;
+		if (SpareList.empty())
+		{
+			node = new Node();
+			nodeCount++;
+		}
+		else
+		{
+			node = SpareList.back();
+			SpareList.pop_back();
+		}
+		node->value = value;
+		node->version = ++version;
+		Node *old = current.exchange(node);
+		if (old != nullptr) RetiredList.push_back(old);
+		// a reader arriving from now on sees the new value, so with none inside the old ones are free
+		if (readers.load() == 0)
+		{
+			SpareList.insert(SpareList.end(), RetiredList.begin(), RetiredList.end());
+			RetiredList.clear();
+		}
+	}
+
+	// Copy out the value, returning its version (0 if never written)
+	uint64_t Load(V &value) const
+	{
+		readers.fetch_add(1);
+		const Node *node = current.load();
+		uint64_t loaded = 0;
+		if (node != nullptr)
+		{
+			value = node->value;
+			loaded = node->version;
+		}
+		readers.fetch_sub(1);
+		return loaded;
+	}
+
+	// Get the number of writes so far
+	uint64_t GetVersion() const
+	{
+		const Node *node = current.load();
+		return (node == nullptr ? 0 : node->version);
+	}
+
+	// Get the number of copies of the value ever allocated (writer only)
+	size_t GetNodeCount() const
+	{
+		return nodeCount;
+	}
+
+private:
+	struct Node
+	{
+		V value;
+		uint64_t version;
+	};
+
+	atomic<Node*> current;
+	mutable atomic<long> readers;
+	uint64_t version;
+	size_t nodeCount;
+	vector<Node*> RetiredList;    // replaced, possibly still being read (writer only)
+	vector<Node*> SpareList;      // replaced and no longer read (writer only)
+
+	SnapshotCell(const SnapshotCell&);
+	SnapshotCell& operator=(const SnapshotCell&);
+
+};
+
+/**
+* Table of the latest value per key, written by one thread and read by any, without locks.
+* Each key has a slot that never moves: a SeqLock for trivially copyable values, a
+* SnapshotCell otherwise. The directory from keys to slots is immutable once published: the
+* writer adds a key by publishing a copy with the key in it through one atomic pointer, so a
+* reader finds a slot with one atomic load and a map lookup. Keys are added rarely (one per
+* product), so the directories replaced are simply kept until the table goes; readers on a
+* hot path can still look a slot up once and keep it.
+* TryGet never inserts: a key that was never stored is simply not found.
+* Type K is the key type and V the value type.
+*/
+template<typename K, typename V>
+class SnapshotTable
+{
+
+public:
+
+	typedef typename conditional<is_trivially_copyable<V>::value, SeqLock<V>, SnapshotCell<V>>::type Slot;
+
+	SnapshotTable()
+	{
+		DirectoryList.push_back(new Directory());
+		directory.store(DirectoryList.back(), memory_order_release);
+	}
+
+	~SnapshotTable()
+	{
+		for (size_t i = 0; i < DirectoryList.size(); i++) delete DirectoryList[i];
+	}
+
+	// Publish the latest value of a key (single writer only)
+	void Store(const K &key, const V &value)
+	{
+		const Directory *current = directory.load(memory_order_relaxed);
+		auto it = current->find(key);
+		if (it != current->end())
+		{
+			it->second->Store(value);
+			return;
+		}
+		Slots.emplace_back();
+		Slot *slot = &Slots.back();
+		slot->Store(value);
+		Directory *next = new Directory(*current);
+		next->insert(pair<K, Slot*>(key, slot));
+		DirectoryList.push_back(next);
+		directory.store(next, memory_order_release);
+	}
+
+	// Get the slot of a key, or nullptr if it was never stored (any thread, lock-free).
+	// The slot lives as long as the table, so readers can look it up once and keep it.
+	const Slot* GetSlot(const K &key) const
+	{
+		const Directory *current = directory.load(memory_order_acquire);
+		auto it = current->find(key);
+		return (it == current->end() ? nullptr : it->second);
+	}
+
+	// Copy out the latest value of a key (any thread, lock-free); false if it was never stored
+	bool TryGet(const K &key, V &value, uint64_t *version = nullptr) const
+	{
+		const Slot *slot = GetSlot(key);
+		if (slot == nullptr) return false;
+		uint64_t loaded = slot->Load(value);
+		if (version != nullptr) *version = loaded;
+		return loaded != 0;
+	}
+
+	// Get the number of keys stored (any thread)
+	size_t GetSize() const
+	{
+		return directory.load(memory_order_acquire)->size();
+	}
+
+private:
+	typedef map<K, Slot*> Directory;
+
+	deque<Slot> Slots;                    // one slot per key, never moved (writer only)
+	atomic<const Directory*> directory;   // the latest directory, never changed once published
+	vector<Directory*> DirectoryList;     // every directory published (writer only)
+
+	SnapshotTable(const SnapshotTable&);
+	SnapshotTable& operator=(const SnapshotTable&);
+
+};
+
+#endif
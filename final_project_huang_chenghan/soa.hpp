@@ -9,6 +9,8 @@
 #define SOA_HPP
 
 #include <vector>
+#include <cstddef>
+#include <utility>
 
 using namespace std;
 
@@ -32,6 +34,18 @@ public:
   // Listener callback to process an update event to the Service
   virtual void ProcessUpdate(V &data) = 0;
 
+  // Listener callback to process count add events at once; by default one ProcessAdd each
+  virtual void ProcessAddBatch(V *data, size_t count)
+  {
+    for (size_t i = 0; i < count; i++) ProcessAdd(data[i]);
+  }
+
+  // Listener callback to process count add events of data held by the Service; by default one ProcessAdd each
+  virtual void ProcessAddBatch(V *const *data, size_t count)
+  {
+    for (size_t i = 0; i < count; i++) ProcessAdd(*data[i]);
+  }
+
 };
 
 /**
@@ -50,6 +64,19 @@ public:
   // The callback that a Connector should invoke for any new or updated data
   virtual void OnMessage(V &data) = 0;
 
+  // The callback for data the Connector no longer needs, which the Service may move from;
+  // by default the same as OnMessage(V&)
+  virtual void OnMessage(V &&data)
+  {
+    OnMessage(data);
+  }
+
+  // The callback for a block of count new or updated data; by default one OnMessage each
+  virtual void OnMessageBatch(V *data, size_t count)
+  {
+    for (size_t i = 0; i < count; i++) OnMessage(data[i]);
+  }
+
   // Add a listener to the Service for callbacks on add, remove, and update events
   // for data to the Service.
   virtual void AddListener(ServiceListener<V> *listener) = 0;
@@ -8,10 +8,18 @@
 #define STREAMING_SERVICE_HPP
 
 #include <iostream>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
 #include "soa.hpp"
 #include "marketdataservice.hpp"
 #include "pricingservice.hpp"
 #include "riskservice.hpp"
+#include "pipeline.hpp"
 //#include "products.hpp"
 //#include "historicaldataservice.hpp"
 
@@ -103,6 +111,12 @@ private:
  * Streaming service to publish two-way prices.
  * Keyed on product identifier.
  * Type T is the product type.
+ * When throttled, a product's stream is only forwarded to listeners once either side has
+ * moved by minMoveTicks since it was last published or minIntervalMs has elapsed; otherwise
+ * it is held as the latest stream for the product. A heartbeat thread, once started, publishes
+ * a held stream when minIntervalMs have passed since its product was last published, so the
+ * last move before a quiet spell still goes out; Flush() publishes every held stream at once.
+ * Publishing is serialized under a mutex, as both the pricing and the heartbeat thread do it.
  */
 template<typename T>
 class StreamingService : public Service<string,PriceStream<T>>
@@ -117,33 +131,174 @@ public:
 		return &instance;
 	}
 
-	void PublishPrice(PriceStream<T>& priceStream)
+	void PublishPrice(const PriceStream<T>& priceStream)
 	{
-		T product = priceStream.GetProduct();
-		string product_ID = product.GetProductId();
+		Pipeline<> none;
+		PublishPrice(priceStream, none);
+	}
+
+	// Publish a stream, passing it down a static pipeline as well as to the listeners.
+	// The stream is copied once, into StreamMap, and that copy is what gets published.
+	template<typename Next>
+	void PublishPrice(const PriceStream<T>& _priceStream, Next &next)
+	{
+		const string &product_ID = _priceStream.GetProduct().GetProductId();
+		lock_guard<mutex> lock(publishMutex);
 
 		auto it = StreamMap.find(product_ID);
 		if (it == StreamMap.end()) {
-			AddStream(priceStream);
+			it = StreamMap.emplace(product_ID, _priceStream).first;
+		}
+		else {
+			it->second = _priceStream;
+		}
+		PriceStream<T> &priceStream = it->second;
+
+		if (throttle)
+		{
+			ThrottleState &state = ThrottleMap[product_ID];
+			std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+			double bidMove = abs(priceStream.GetBidOrder().GetPrice() - state.bidPrice) * TICKS_PER_POINT;
+			double offerMove = abs(priceStream.GetOfferOrder().GetPrice() - state.offerPrice) * TICKS_PER_POINT;
+			if (state.published && bidMove < minMoveTicks && offerMove < minMoveTicks
+				&& now - state.publishTime < std::chrono::milliseconds(minIntervalMs))
+			{
+				state.pending = true;
+				suppressedCount++;
+				return;
+			}
+			state.published = true;
+			state.pending = false;
+			state.bidPrice = priceStream.GetBidOrder().GetPrice();
+			state.offerPrice = priceStream.GetOfferOrder().GetPrice();
+			state.publishTime = now;
+		}
+
+		PushToListeners(priceStream, next);
+	}
+
+	// Forward only moves of at least _minMoveTicks on either side, or after _minIntervalMs;
+	// set before starting the heartbeat
+	void SetThrottle(bool _throttle, double _minMoveTicks, long _minIntervalMs)
+	{
+		if (throttle && !_throttle) Flush();
+		throttle = _throttle;
+		minMoveTicks = _minMoveTicks;
+		minIntervalMs = _minIntervalMs;
+	}
+
+	// Start the heartbeat thread, waking four times per throttle interval
+	void StartHeartbeat()
+	{
+		StartHeartbeat(noStages);
+	}
+
+	// Start the heartbeat thread, publishing down a static pipeline that must outlive it
+	template<typename Next>
+	void StartHeartbeat(Next &next)
+	{
+		lock_guard<mutex> lock(heartbeatMutex);
+		if (running) return;
+		running = true;
+		flushExpired = [this, &next] { FlushExpired(next); };
+		heartbeat = thread(&StreamingService<T>::RunHeartbeat, this);
+	}
+
+	// Stop the heartbeat thread; streams it has not published stay held for Flush
+	void StopHeartbeat()
+	{
+		{
+			lock_guard<mutex> lock(heartbeatMutex);
+			if (!running) return;
+			running = false;
+		}
+		wakeup.notify_all();
+		heartbeat.join();
+	}
+
+	// Publish the held streams of the products last published minIntervalMs or more ago
+	void FlushExpired()
+	{
+		FlushExpired(noStages);
+	}
+
+	// Publish the expired held streams down a static pipeline as well as to the listeners
+	template<typename Next>
+	void FlushExpired(Next &next)
+	{
+		lock_guard<mutex> lock(publishMutex);
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		for (auto it = ThrottleMap.begin(); it != ThrottleMap.end(); it++)
+		{
+			if (!it->second.pending || now - it->second.publishTime < std::chrono::milliseconds(minIntervalMs)) continue;
+			PublishHeld(it, next);
+		}
+	}
+
+	// Publish the latest stream of every product holding a suppressed update
+	void Flush()
+	{
+		Pipeline<> none;
+		Flush(none);
+	}
+
+	// Publish the held streams down a static pipeline as well as to the listeners
+	template<typename Next>
+	void Flush(Next &next)
+	{
+		lock_guard<mutex> lock(publishMutex);
+		for (auto it = ThrottleMap.begin(); it != ThrottleMap.end(); it++)
+		{
+			if (it->second.pending) PublishHeld(it, next);
 		}
+	}
+
+	// Push every published stream to clients through a publisher connector as well as to listeners
+	void SetConnector(Connector<PriceStream<T>>* _connector)
+	{
+		connector = _connector;
+	}
+
+	void PushToListeners(PriceStream<T> &priceStream)
+	{
+		Pipeline<> none;
+		PushToListeners(priceStream, none);
+	}
 
+	template<typename Next>
+	void PushToListeners(PriceStream<T> &priceStream, Next &next)
+	{
+		publishedCount++;
+		if (connector != nullptr) connector->Publish(priceStream);
+		next.Push(priceStream);
 		for (int i = 0; i < ListenerList.size(); i++)
 		{
 			ServiceListener<PriceStream<T>>* listener = ListenerList[i];
 			listener->ProcessAdd(priceStream);
 		}
+	}
+
+	// Get the number of streams forwarded to listeners
+	long GetPublishedCount() const
+	{
+		return publishedCount;
+	}
 
+	// Get the number of streams held back by the throttle
+	long GetSuppressedCount() const
+	{
+		return suppressedCount;
 	}
 
 	void AddStream(PriceStream<T> &_stream)
 	{
-		T BondProduct = _stream.GetProduct();
-		StreamMap.insert(pair<string, PriceStream<T>>(BondProduct.GetProductId(), _stream));
+		const string &id = _stream.GetProduct().GetProductId();
+		if (StreamMap.find(id) == StreamMap.end()) StreamMap.emplace(id, _stream);
 	}
 
 	virtual PriceStream<T>& GetData(string _id)
 	{
-		return StreamMap[_id];
+		return StreamMap.at(_id);
 	}
 
 	virtual void OnMessage(PriceStream<T> &data) {}
@@ -157,6 +312,65 @@ public:
 	{
 		return ListenerList;
 	}
+
+	~StreamingService()
+	{
+		StopHeartbeat();
+	}
+
+private:
+	struct ThrottleState
+	{
+		bool published = false;
+		bool pending = false;
+		double bidPrice = 0;
+		double offerPrice = 0;
+		std::chrono::steady_clock::time_point publishTime;
+	};
+
+	map<string, ThrottleState> ThrottleMap;
+	Connector<PriceStream<T>>* connector = nullptr;
+	bool throttle = false;
+	double minMoveTicks = 1;
+	long minIntervalMs = 0;
+	atomic<long> publishedCount{0};     // read from any thread
+	atomic<long> suppressedCount{0};
+	mutex publishMutex;       // held while publishing, by the pricing and the heartbeat thread
+
+	thread heartbeat;
+	function<void()> flushExpired;    // FlushExpired down the pipeline the heartbeat was started with
+	Pipeline<> noStages;
+	bool running = false;
+	mutex heartbeatMutex;
+	condition_variable wakeup;
+
+	// Publish the stream a product holds; publishMutex must be held
+	template<typename Next>
+	void PublishHeld(typename map<string, ThrottleState>::iterator it, Next &next)
+	{
+		ThrottleState &state = it->second;
+		PriceStream<T> &priceStream = StreamMap[it->first];
+		state.pending = false;
+		state.bidPrice = priceStream.GetBidOrder().GetPrice();
+		state.offerPrice = priceStream.GetOfferOrder().GetPrice();
+		state.publishTime = std::chrono::steady_clock::now();
+		PushToListeners(priceStream, next);
+	}
+
+	void RunHeartbeat()
+	{
+		std::chrono::milliseconds period(minIntervalMs > 4 ? minIntervalMs / 4 : 1);
+		auto next = std::chrono::steady_clock::now() + period;
+		unique_lock<mutex> lock(heartbeatMutex);
+		while (running)
+		{
+			if (wakeup.wait_until(lock, next, [this] { return !running; })) break;
+			lock.unlock();
+			flushExpired();
+			lock.lock();
+			next += period;
+		}
+	}
 };
 
 
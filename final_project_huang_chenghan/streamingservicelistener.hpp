@@ -8,6 +8,7 @@
 #include "streamingservice.hpp"
 #include "riskservice.hpp"
 #include "historicaldataservice.hpp"
+#include "pipeline.hpp"
 
 template<typename T>
 class StreamingServiceListener : public ServiceListener<PriceStream<T>>
@@ -44,4 +45,29 @@ private:
 	}
 };
 
+/**
+* Static pipeline stage doing the work of StreamingServiceListener: stream -> streaming.txt.
+* Type T is the product type.
+*/
+template<typename T>
+class StreamingStage : public PipelineStage
+{
+public:
+	StreamingStage()
+	{
+		_bondHistoryStreamingService = BondHistoricalStreamingService::Generate_Instance();
+	}
+
+	template<typename Next>
+	void Process(PriceStream<T> &data, Next &next)
+	{
+		_bondHistoryStreamingService->OnMessage(data);
+		_bondHistoryStreamingService->PersistData(data.GetProduct().GetProductId(), data);
+		next.Push(data);
+	}
+
+private:
+	BondHistoricalStreamingService* _bondHistoryStreamingService;
+};
+
 #endif
\ No newline at end of file
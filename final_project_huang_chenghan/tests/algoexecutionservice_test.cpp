@@ -0,0 +1,111 @@
+/**
+* algoexecutionservice_test.cpp
+* TWAP and iceberg parent orders worked tick by tick against the exchange simulator until they complete.
+*
+* @author Chenghan Huang
+*/
+#include "products.hpp"
+#include "tradebookingservice.hpp"
+#include "executionservice.hpp"
+#include "exchangesimulator.hpp"
+#include "algoexecutionservice.hpp"
+#include "algoexecutionservicelistener.hpp"
+#include "testing.hpp"
+
+static Bond TestBond(const string &id)
+{
+	return Bond(id, CUSIP, "T", 0.01f, date(2030, 1, 15));
+}
+
+// Sell _quantity into the CME book of _bond from outside, at _price or better
+static void OutsideSell(ExchangeSimulator<Bond> &exchange, const Bond &bond, double price, long quantity, uint64_t sequence)
+{
+	exchange.GetBook(bond, CME)->Submit(OFFER, LIMIT, (int32_t)lround(price * TICKS_PER_POINT), quantity,
+		IdGenerator::Make(IdGenerator::EXTERNAL_SESSION, sequence));
+}
+
+// A TWAP parent sends a market slice every other tick and is done once the last one fills
+static void TestTwap(ExchangeSimulator<Bond> &exchange, AlgoExecutionService<Bond> &algo)
+{
+	Bond bond = TestBond("TWAP");
+	vector<Order> bids;
+	vector<Order> offers;
+	offers.push_back(Order(100.0, 10000000, OFFER));
+	exchange.LoadBook(OrderBook<Bond>(bond, bids, offers), CME);
+
+	algo.SetSlicing(TWAP, 4, 2, 1000000);
+	AggressDecision decision = { BID, 100.0, 4000000 };
+	IdType parentId = algo.ConvertToExecutionOrder(bond, decision).GetOrderId();
+	CHECK(algo.GetParentOrder(parentId).GetChildCount() == 1);
+	CHECK(algo.GetParentOrder(parentId).GetFilledQuantity() == 1000000);
+	CHECK(algo.GetScheduledSlices() == 1);
+
+	algo.OnTimer();
+	CHECK(algo.GetParentOrder(parentId).GetChildCount() == 1);
+	algo.OnTimer();
+	CHECK(algo.GetParentOrder(parentId).GetChildCount() == 2);
+	CHECK(algo.GetParentOrder(parentId).GetFilledQuantity() == 2000000);
+
+	for (int tick = 0; tick < 4; tick++) algo.OnTimer();
+	CHECK(algo.ParentOrderMap.count(parentId) == 0);
+	CHECK(algo.GetScheduledSlices() == 0);
+	int32_t priceTicks;
+	long quantity;
+	CHECK(exchange.GetBook(bond, CME)->GetTouch(OFFER, priceTicks, quantity));
+	CHECK(quantity == 6000000);
+}
+
+// An iceberg parent rests one child at a time; the venue's fills on it, partial ones included,
+// reach the parent, and the next child goes out on the tick after the working one is filled
+static void TestIceberg(ExchangeSimulator<Bond> &exchange, AlgoExecutionService<Bond> &algo)
+{
+	Bond bond = TestBond("ICEBERG");
+	algo.SetSlicing(ICEBERG, 1, 1, 1000000);
+	AggressDecision decision = { BID, 99.5, 3000000 };
+	IdType parentId = algo.ConvertToExecutionOrder(bond, decision).GetOrderId();
+	CHECK(algo.GetParentOrder(parentId).GetChildCount() == 1);
+	CHECK(algo.GetParentOrder(parentId).GetWorkingQuantity() == 1000000);
+	CHECK(algo.RestingChildMap.size() == 1);
+
+	OutsideSell(exchange, bond, 99.5, 600000, 1);
+	algo.OnTimer();
+	CHECK(algo.GetParentOrder(parentId).GetFilledQuantity() == 600000);
+	CHECK(algo.GetParentOrder(parentId).GetChildCount() == 1);
+
+	OutsideSell(exchange, bond, 99.5, 400000, 2);
+	CHECK(algo.GetParentOrder(parentId).GetChildCount() == 1);
+	algo.OnTimer();
+	CHECK(algo.GetParentOrder(parentId).GetFilledQuantity() == 1000000);
+	CHECK(algo.GetParentOrder(parentId).GetChildCount() == 2);
+
+	// more than the child shows: only what rests trades, and the rest of the outside order waits
+	// at the price for the next child, which takes it on arrival and rests what it still shows
+	OutsideSell(exchange, bond, 99.5, 1500000, 3);
+	algo.OnTimer();
+	CHECK(algo.GetParentOrder(parentId).GetFilledQuantity() == 2500000);
+	CHECK(algo.GetParentOrder(parentId).GetChildCount() == 3);
+	CHECK(algo.GetParentOrder(parentId).GetWorkingQuantity() == 500000);
+	CHECK(exchange.GetBook(bond, CME)->GetDepth(OFFER) == 0);
+
+	OutsideSell(exchange, bond, 99.5, 500000, 4);
+	CHECK(algo.ParentOrderMap.count(parentId) == 1);
+	algo.OnTimer();
+	CHECK(algo.ParentOrderMap.count(parentId) == 0);
+	CHECK(algo.RestingChildMap.empty());
+	CHECK(exchange.GetBook(bond, CME)->GetDepth(BID) == 0);
+}
+
+int main()
+{
+	IdGenerator::StartProcessSession(1);
+	ExchangeSimulator<Bond> *exchange = ExchangeSimulator<Bond>::Generate_Instance();
+	ExecutionService<Bond>::Generate_Instance()->SetVenue(exchange);
+	AlgoExecutionServiceListener<Bond> *listener = AlgoExecutionServiceListener<Bond>::Generate_Instance();
+	AlgoExecutionService<Bond> *algo = listener->GetService();
+	algo->AddListener(listener);
+	exchange->AddListener(algo);
+
+	TestTwap(*exchange, *algo);
+	TestIceberg(*exchange, *algo);
+	return TestResult("algoexecutionservice_test");
+}
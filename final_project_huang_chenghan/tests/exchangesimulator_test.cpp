@@ -0,0 +1,212 @@
+/**
+* exchangesimulator_test.cpp
+* Rest, match, cancel and FOK/IOC/MARKET handling of the exchange simulator, and the fills it
+* reports back through the ExecutionService.
+*
+* @author Chenghan Huang
+*/
+#include "products.hpp"
+#include "tradebookingservice.hpp"
+#include "executionservice.hpp"
+#include "exchangesimulator.hpp"
+#include "testing.hpp"
+
+/**
+* Fill listener keeping every fill it is told about.
+*/
+class RecordingFillListener : public FillListener<Bond>
+{
+public:
+	vector<ExchangeFill<Bond>> FillList;
+
+	void OnFill(const ExchangeFill<Bond> &fill) override
+	{
+		FillList.push_back(fill);
+	}
+};
+
+static Bond TestBond(const string &id)
+{
+	return Bond(id, CUSIP, "T", 0.01f, date(2030, 1, 15));
+}
+
+// A limit order that does not cross rests at its price
+static void TestRest(ExchangeSimulator<Bond> &exchange)
+{
+	Bond bond = TestBond("REST");
+	MatchingBook<Bond> *book = exchange.GetBook(bond, CME);
+	SubmitResult result = book->Submit(BID, LIMIT, 25600, 5000000, 1);
+	CHECK(result.status == ORDER_RESTING);
+	CHECK(result.filledQuantity == 0);
+	int32_t priceTicks;
+	long quantity;
+	CHECK(book->GetTouch(BID, priceTicks, quantity));
+	CHECK(priceTicks == 25600 && quantity == 5000000);
+	CHECK(!book->GetTouch(OFFER, priceTicks, quantity));
+
+	// a better bid becomes the touch, a worse one queues behind it
+	book->Submit(BID, LIMIT, 25601, 1000000, 2);
+	book->Submit(BID, LIMIT, 25599, 1000000, 3);
+	CHECK(book->GetTouch(BID, priceTicks, quantity));
+	CHECK(priceTicks == 25601 && quantity == 1000000);
+	CHECK(book->GetDepth(BID) == 3);
+}
+
+// An order crossing the book trades with price-time priority and reports both sides
+static void TestMatch(ExchangeSimulator<Bond> &exchange, RecordingFillListener &fills)
+{
+	Bond bond = TestBond("MATCH");
+	MatchingBook<Bond> *book = exchange.GetBook(bond, BROKERTEC);
+	book->Submit(OFFER, LIMIT, 25610, 2000000, 10);
+	book->Submit(OFFER, LIMIT, 25610, 3000000, 11);
+	book->Submit(OFFER, LIMIT, 25612, 4000000, 12);
+
+	fills.FillList.clear();
+	SubmitResult result = book->Submit(BID, LIMIT, 25611, 3000000, 13);
+	CHECK(result.status == ORDER_FILLED);
+	CHECK(result.filledQuantity == 3000000);
+	CHECK(result.averagePriceTicks == 25610);
+	// the first order at the level trades first, in full, then part of the second
+	CHECK(fills.FillList.size() == 4);
+	if (fills.FillList.size() == 4)
+	{
+		CHECK(fills.FillList[0].aggressor && fills.FillList[0].contraOrderId == 10 && fills.FillList[0].quantity == 2000000);
+		CHECK(!fills.FillList[1].aggressor && fills.FillList[1].orderId == 10 && fills.FillList[1].leavesQuantity == 0);
+		CHECK(fills.FillList[2].contraOrderId == 11 && fills.FillList[2].quantity == 1000000);
+		CHECK(fills.FillList[3].orderId == 11 && fills.FillList[3].leavesQuantity == 2000000);
+	}
+	int32_t priceTicks;
+	long quantity;
+	CHECK(book->GetTouch(OFFER, priceTicks, quantity));
+	CHECK(priceTicks == 25610 && quantity == 2000000);
+
+	// sweeping two levels averages the price and rests the remainder of a limit order
+	result = book->Submit(BID, LIMIT, 25612, 8000000, 14);
+	CHECK(result.status == ORDER_RESTING);
+	CHECK(result.filledQuantity == 6000000);
+	CHECK(result.averagePriceTicks == (2000000.0 * 25610 + 4000000.0 * 25612) / 6000000);
+	CHECK(book->GetDepth(OFFER) == 0);
+	CHECK(book->GetTouch(BID, priceTicks, quantity));
+	CHECK(priceTicks == 25612 && quantity == 2000000);
+}
+
+// A resting order cancels once, by its handle and id
+static void TestCancel(ExchangeSimulator<Bond> &exchange)
+{
+	Bond bond = TestBond("CANCEL");
+	MatchingBook<Bond> *book = exchange.GetBook(bond, ESPEED);
+	SubmitResult first = book->Submit(OFFER, LIMIT, 25620, 1000000, 20);
+	SubmitResult second = book->Submit(OFFER, LIMIT, 25620, 2000000, 21);
+	CHECK(!book->Cancel(first.handle, 99));
+	CHECK(book->Cancel(first.handle, 20));
+	CHECK(!book->Cancel(first.handle, 20));
+	int32_t priceTicks;
+	long quantity;
+	CHECK(book->GetTouch(OFFER, priceTicks, quantity));
+	CHECK(quantity == 2000000);
+	CHECK(book->Cancel(second.handle, 21));
+	CHECK(book->GetDepth(OFFER) == 0);
+
+	// a filled order is no longer resting
+	SubmitResult resting = book->Submit(BID, LIMIT, 25600, 1000000, 22);
+	book->Submit(OFFER, MARKET, 0, 1000000, 23);
+	CHECK(!book->Cancel(resting.handle, 22));
+}
+
+// FOK trades in full or not at all; IOC and MARKET cancel their remainder; STOP is rejected
+static void TestImmediateOrders(ExchangeSimulator<Bond> &exchange)
+{
+	Bond bond = TestBond("FOK");
+	MatchingBook<Bond> *book = exchange.GetBook(bond, CME);
+	book->Submit(OFFER, LIMIT, 25630, 1000000, 30);
+	book->Submit(OFFER, LIMIT, 25632, 1000000, 31);
+
+	SubmitResult result = book->Submit(BID, FOK, 25631, 2000000, 32);
+	CHECK(result.status == ORDER_CANCELLED);
+	CHECK(result.filledQuantity == 0);
+	CHECK(book->GetDepth(OFFER) == 2);
+
+	result = book->Submit(BID, IOC, 25631, 2000000, 33);
+	CHECK(result.status == ORDER_PARTIALLY_FILLED);
+	CHECK(result.filledQuantity == 1000000);
+	CHECK(book->GetDepth(BID) == 0);
+
+	result = book->Submit(BID, FOK, 25632, 1000000, 34);
+	CHECK(result.status == ORDER_FILLED);
+	CHECK(book->GetDepth(OFFER) == 0);
+
+	book->Submit(OFFER, LIMIT, 25640, 1000000, 35);
+	result = book->Submit(BID, MARKET, 0, 3000000, 36);
+	CHECK(result.status == ORDER_PARTIALLY_FILLED);
+	CHECK(result.filledQuantity == 1000000);
+	CHECK(book->GetDepth(BID) == 0);
+
+	CHECK(book->Submit(BID, STOP, 25640, 1000000, 37).status == ORDER_REJECTED);
+	CHECK(book->Submit(BID, LIMIT, 25640, 0, 38).status == ORDER_REJECTED);
+}
+
+// With the simulator as its venue the ExecutionService reports only what traded, and the
+// fills carry the id of the execution order against the outside id of the seeded liquidity;
+// what rests is booked when it fills later
+static void TestExecutionVenue(ExchangeSimulator<Bond> &exchange, RecordingFillListener &fills)
+{
+	Bond bond = TestBond("VENUE");
+	vector<Order> bids;
+	vector<Order> offers;
+	offers.push_back(Order(100.0, 1000000, OFFER));
+	OrderBook<Bond> orderbook(bond, bids, offers);
+	exchange.LoadBook(orderbook, CME);
+
+	ExecutionService<Bond> *executionService = ExecutionService<Bond>::Generate_Instance();
+	executionService->SetVenue(&exchange);
+	ExecutionOrder<Bond> order(bond, BID, 41, MARKET, 100.0, 3000000, 0, 0, false);
+	fills.FillList.clear();
+	CHECK(executionService->ExecuteOrder(order, CME) == 1000000);
+	CHECK(fills.FillList.size() == 2);
+	if (fills.FillList.size() == 2)
+	{
+		CHECK(fills.FillList[0].aggressor && fills.FillList[0].orderId == 41);
+		CHECK(IdGenerator::GetSession(fills.FillList[0].contraOrderId) == IdGenerator::EXTERNAL_SESSION);
+		CHECK(fills.FillList[1].contraOrderId == 41);
+	}
+	CHECK(executionService->ExecuteOrder(order, CME) == 0);
+
+	// a limit order's remainder rests, and is booked to one book as the venue fills it
+	TradeBookingService<Bond> *booking = TradeBookingService<Bond>::Generate_Instance();
+	executionService->SetTradeBooking(booking, 1, 1000);
+	ExecutionOrder<Bond> limit(bond, OFFER, 42, LIMIT, 100.5, 2000000, 0, 0, false);
+	CHECK(executionService->ExecuteOrder(limit, CME) == 0);
+	CHECK(executionService->RestingOrderMap.count(42) == 1);
+	MatchingBook<Bond> *book = exchange.GetBook(bond, CME);
+	book->Submit(BID, LIMIT, 25728, 1500000, IdGenerator::Make(IdGenerator::EXTERNAL_SESSION, 100));
+	book->Submit(BID, LIMIT, 25728, 1000000, IdGenerator::Make(IdGenerator::EXTERNAL_SESSION, 101));
+	CHECK(executionService->RestingOrderMap.count(42) == 0);
+	CHECK(booking->BookMap.size() == 2);
+	if (booking->BookMap.size() == 2)
+	{
+		const Trade<Bond> &first = booking->BookMap.begin()->second;
+		const Trade<Bond> &last = booking->BookMap.rbegin()->second;
+		CHECK(first.GetQuantity() == 1500000 && last.GetQuantity() == 500000);
+		CHECK(first.GetPrice() == 100.5 && first.GetSide() == SELL);
+		CHECK(first.GetBook() == last.GetBook());
+	}
+	executionService->SetTradeBooking(nullptr, 0, 0);
+
+	executionService->SetVenue(nullptr);
+	CHECK(executionService->ExecuteOrder(order, CME) == 3000000);
+}
+
+int main()
+{
+	IdGenerator::StartProcessSession(1);
+	ExchangeSimulator<Bond> *exchange = ExchangeSimulator<Bond>::Generate_Instance();
+	RecordingFillListener fills;
+	exchange->AddListener(&fills);
+
+	TestRest(*exchange);
+	TestMatch(*exchange, fills);
+	TestCancel(*exchange);
+	TestImmediateOrders(*exchange);
+	TestExecutionVenue(*exchange, fills);
+	return TestResult("exchangesimulator_test");
+}
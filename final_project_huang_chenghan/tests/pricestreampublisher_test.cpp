@@ -0,0 +1,112 @@
+/**
+* pricestreampublisher_test.cpp
+* Sequencing, publisher restarts and malformed datagrams on the UDP price stream receiver.
+*
+* @author Chenghan Huang
+*/
+#include "products.hpp"
+#include "tradebookingservice.hpp"
+#include "positionservice.hpp"
+#include "riskservice.hpp"
+#include "pricingservice.hpp"
+#include "streamingservice.hpp"
+#include "pricestreampublisher.hpp"
+#include "testing.hpp"
+
+// Get a loopback port of this process, so parallel test runs do not share it
+static uint16_t TestPort()
+{
+	return (uint16_t)(30000 + getpid() % 20000);
+}
+
+static void SendPacket(UdpPacketSender &sender, uint64_t session, uint64_t sequence)
+{
+	PriceStreamPacket packet;
+	memset(&packet, 0, sizeof(packet));
+	strcpy(packet.productId, "UDPTEST");
+	packet.session = session;
+	packet.sequence = sequence;
+	sender.Send(&packet, sizeof(packet));
+}
+
+// Drain the receiver, keeping the sequence of every packet it hands over
+static vector<uint64_t> ReceiveAll(UdpPriceStreamReceiver &receiver)
+{
+	vector<uint64_t> sequences;
+	PriceStreamPacket packet;
+	while (receiver.Receive(packet)) sequences.push_back(packet.sequence);
+	return sequences;
+}
+
+// Gaps are counted and packets already seen are dropped
+static void TestSequence(UdpPacketSender &sender, UdpPriceStreamReceiver &receiver)
+{
+	SendPacket(sender, 5, 0);
+	SendPacket(sender, 5, 1);
+	SendPacket(sender, 5, 3);
+	SendPacket(sender, 5, 1);
+	vector<uint64_t> sequences = ReceiveAll(receiver);
+	CHECK(sequences.size() == 3);
+	CHECK(sequences.size() == 3 && sequences[2] == 3);
+	CHECK(receiver.GetGaps() == 1);
+	CHECK(receiver.GetDuplicates() == 1);
+}
+
+// A restarted publisher counts from 0 again in a later session; the old session is stale
+static void TestRestart(UdpPacketSender &sender, UdpPriceStreamReceiver &receiver)
+{
+	SendPacket(sender, 9, 0);
+	SendPacket(sender, 9, 1);
+	SendPacket(sender, 5, 4);
+	vector<uint64_t> sequences = ReceiveAll(receiver);
+	CHECK(sequences.size() == 2);
+	CHECK(sequences.size() == 2 && sequences[0] == 0 && sequences[1] == 1);
+	CHECK(receiver.GetRestarts() == 1);
+	CHECK(receiver.GetGaps() == 1);
+	CHECK(receiver.GetDuplicates() == 2);
+}
+
+// Datagrams that are not one packet long are skipped, not taken for the end of the stream
+static void TestMalformed(UdpPacketSender &sender, UdpPriceStreamReceiver &receiver)
+{
+	char bytes[100];
+	memset(bytes, 0, sizeof(bytes));
+	sender.Send(bytes, 10);
+	sender.Send(bytes, sizeof(bytes));
+	SendPacket(sender, 9, 2);
+	vector<uint64_t> sequences = ReceiveAll(receiver);
+	CHECK(sequences.size() == 1 && sequences[0] == 2);
+	CHECK(receiver.GetMalformed() == 2);
+}
+
+// The fan-out connector stamps its session on the packets it sends
+static void TestFanout(UdpPriceStreamReceiver &receiver)
+{
+	Bond bond("UDPTEST", CUSIP, "T", 0.01f, date(2030, 1, 15));
+	BondProductService::Generate_Instance()->Add(bond);
+	PriceStreamFanoutConnector *connector = PriceStreamFanoutConnector::Generate_Instance();
+	connector->EnableUdp("239.255.0.1", TestPort(), true);
+	PriceStream<Bond> stream(bond, PriceStreamOrder(99.5, 1000000, 2000000, BID), PriceStreamOrder(99.5 + 2 / 256., 1000000, 2000000, OFFER));
+	connector->Publish(stream);
+
+	PriceStreamPacket packet;
+	CHECK(receiver.Receive(packet));
+	CHECK(packet.session == connector->GetSession() && packet.sequence == 0);
+	CHECK(receiver.GetRestarts() == 2);
+	PriceStream<Bond> received = DecodePriceStream(packet, BondProductService::Generate_Instance());
+	CHECK(received.GetProduct().GetProductId() == "UDPTEST");
+	CHECK(received.GetBidOrder().GetPrice() == 99.5);
+	CHECK(received.GetOfferOrder().GetHiddenQuantity() == 2000000);
+}
+
+int main()
+{
+	UdpPriceStreamReceiver receiver("239.255.0.1", TestPort(), true);
+	UdpPacketSender sender("239.255.0.1", TestPort(), true);
+
+	TestSequence(sender, receiver);
+	TestRestart(sender, receiver);
+	TestMalformed(sender, receiver);
+	TestFanout(receiver);
+	return TestResult("pricestreampublisher_test");
+}
@@ -0,0 +1,190 @@
+/**
+* shmconnector_test.cpp
+* Round trips of prices, risk and execution orders through the shared-memory connectors.
+*
+* @author Chenghan Huang
+*/
+#include "products.hpp"
+#include "tradebookingservice.hpp"
+#include "positionservice.hpp"
+#include "riskservice.hpp"
+#include "pricingservice.hpp"
+#include "executionservice.hpp"
+#include "shmconnector.hpp"
+#include "testing.hpp"
+#include <unistd.h>
+
+/**
+* Service keeping every message it is given.
+* Type V is the data type.
+*/
+template<typename V>
+class RecordingService : public Service<string, V>
+{
+public:
+	vector<V> MessageList;
+	vector<ServiceListener<V>*> ListenerList;
+
+	virtual V& GetData(string _id)
+	{
+		return MessageList.back();
+	}
+
+	virtual void OnMessage(V &data)
+	{
+		MessageList.push_back(data);
+		for (int i = 0; i < ListenerList.size(); i++) ListenerList[i]->ProcessAdd(data);
+	}
+
+	virtual void AddListener(ServiceListener<V>* _listener)
+	{
+		ListenerList.push_back(_listener);
+	}
+
+	virtual const vector<ServiceListener<V>*>& GetListeners() const
+	{
+		return ListenerList;
+	}
+};
+
+// Get a ring name of this process, so parallel test runs do not share rings
+static string RingName(const string &suffix)
+{
+	return "/shmconnector_test_" + to_string(getpid()) + "_" + suffix;
+}
+
+// Prices published through a listener reach the subscriber's service in order
+static void TestPrices(const Bond &bond)
+{
+	const Bond *product = &BondProductService::Generate_Instance()->GetData(bond.GetProductId());
+	string name = RingName("prices");
+	ShmPublisherConnector<Price<Bond>> publisher(name, 8);
+	RecordingService<Price<Bond>> source;
+	RecordingService<Price<Bond>> sink;
+	ShmSubscriberConnector<Price<Bond>> reader(name, &sink);
+	ConnectorServiceListener<Price<Bond>> forward(&publisher);
+	source.AddListener(&forward);
+
+	for (int i = 0; i < 3; i++)
+	{
+		Price<Bond> price(product, 25600 + i, 2);
+		source.OnMessage(price);
+	}
+	CHECK(reader.Poll(2) == 2);
+	CHECK(reader.Poll(10) == 1);
+	CHECK(reader.Poll(10) == 0);
+	CHECK(sink.MessageList.size() == 3);
+	for (int i = 0; i < sink.MessageList.size(); i++)
+	{
+		CHECK(sink.MessageList[i].GetProduct().GetProductId() == bond.GetProductId());
+		CHECK(sink.MessageList[i].GetMidTicks() == 25600 + i);
+		CHECK(sink.MessageList[i].GetBidOfferSpreadTicks() == 2);
+	}
+	CHECK(reader.GetLost() == 0);
+}
+
+// A subscriber lapped by the writer skips to the oldest record held and counts the rest lost;
+// Consume reads the records in place, in order
+static void TestLapped(const Bond &bond)
+{
+	string name = RingName("risk");
+	ShmPublisherConnector<PV01<Bond>> publisher(name, 8);
+	RecordingService<PV01<Bond>> sink;
+	ShmSubscriberConnector<PV01<Bond>> reader(name, &sink);
+	ShmSubscriberConnector<PV01<Bond>> consumer(name, &sink);
+
+	for (int i = 0; i < 20; i++)
+	{
+		PV01<Bond> pv01(bond, 0.0001 * (i + 1), 1000000 * i);
+		publisher.Publish(pv01);
+	}
+	reader.Subscribe();
+	CHECK(sink.MessageList.size() == 8);
+	CHECK(reader.GetLost() == 12);
+	if (sink.MessageList.size() == 8)
+	{
+		CHECK(sink.MessageList.front().GetQuantity() == 12000000);
+		CHECK(sink.MessageList.back().GetQuantity() == 19000000);
+	}
+
+	vector<int64_t> quantities;
+	auto quantity = [](const ShmRecord<PV01<Bond>> &record) { return record.quantity; };
+	auto keep = [&quantities](int64_t value) { quantities.push_back(value); };
+	CHECK(consumer.Consume(quantity, keep, 5) == 5);
+	CHECK(quantities.size() == 5);
+	CHECK(!quantities.empty() && quantities.front() == 12000000);
+	CHECK(consumer.Consume(quantity, keep, 100) == 3);
+	CHECK(quantities.size() == 8 && quantities.back() == 19000000);
+	CHECK(consumer.GetLost() == 12);
+}
+
+// What Consume read from a record the writer overwrote meanwhile is dropped, not used
+static void TestLappedWhileReading(const Bond &bond)
+{
+	string name = RingName("reading");
+	ShmPublisherConnector<PV01<Bond>> publisher(name, 8);
+	RecordingService<PV01<Bond>> sink;
+	ShmSubscriberConnector<PV01<Bond>> consumer(name, &sink);
+	PV01<Bond> first(bond, 0.0001, 1);
+	publisher.Publish(first);
+
+	bool lapped = false;
+	vector<int64_t> quantities;
+	int consumed = consumer.Consume([&publisher, &bond, &lapped](const ShmRecord<PV01<Bond>> &record)
+	{
+		int64_t quantity = record.quantity;
+		if (!lapped)
+		{
+			// a whole ring of records lands while the first one is being read
+			lapped = true;
+			for (int i = 0; i < 8; i++)
+			{
+				PV01<Bond> pv01(bond, 0.0001, 100 + i);
+				publisher.Publish(pv01);
+			}
+		}
+		return quantity;
+	}, [&quantities](int64_t quantity) { quantities.push_back(quantity); }, 100);
+	CHECK(consumed == 8);
+	CHECK(quantities.size() == 8 && quantities.front() == 100 && quantities.back() == 107);
+	CHECK(consumer.GetLost() == 1);
+}
+
+// Execution orders keep every field across the ring
+static void TestExecutionOrders(const Bond &bond)
+{
+	string name = RingName("orders");
+	ShmPublisherConnector<ExecutionOrder<Bond>> publisher(name, 4);
+	RecordingService<ExecutionOrder<Bond>> sink;
+	ShmSubscriberConnector<ExecutionOrder<Bond>> reader(name, &sink);
+
+	ExecutionOrder<Bond> order(bond, OFFER, 42, IOC, 99.5, 3000000, 7000000, 41, true);
+	publisher.Publish(order);
+	reader.Subscribe();
+	CHECK(sink.MessageList.size() == 1);
+	if (sink.MessageList.size() == 1)
+	{
+		const ExecutionOrder<Bond> &received = sink.MessageList[0];
+		CHECK(received.GetProduct().GetProductId() == bond.GetProductId());
+		CHECK(received.GetSide() == OFFER);
+		CHECK(received.GetOrderId() == 42);
+		CHECK(received.GetOrderType() == IOC);
+		CHECK(received.GetPrice() == 99.5);
+		CHECK(received.GetVisibleQuantity() == 3000000);
+		CHECK(received.GetHiddenQuantity() == 7000000);
+		CHECK(received.GetParentOrderId() == 41);
+		CHECK(received.IsChildOrder());
+	}
+}
+
+int main()
+{
+	Bond bond("SHMTEST", CUSIP, "T", 0.01f, date(2030, 1, 15));
+	BondProductService::Generate_Instance()->Add(bond);
+
+	TestPrices(bond);
+	TestLapped(bond);
+	TestLappedWhileReading(bond);
+	TestExecutionOrders(bond);
+	return TestResult("shmconnector_test");
+}
@@ -0,0 +1,138 @@
+/**
+* smartorderrouter_test.cpp
+* Routing decisions of the smart order router, costed against the per-venue fill model.
+*
+* @author Chenghan Huang
+*/
+#include "products.hpp"
+#include "tradebookingservice.hpp"
+#include "executionservice.hpp"
+#include "smartorderrouter.hpp"
+#include "venuefillmodel.hpp"
+#include "testing.hpp"
+
+static Bond TestBond(const string &id)
+{
+	return Bond(id, CUSIP, "T", 0.01f, date(2030, 1, 15));
+}
+
+// A consolidated book three levels deep on each side around 100
+static OrderBook<Bond> TestBook(const Bond &bond)
+{
+	vector<Order> bids;
+	vector<Order> offers;
+	long sizes[3] = { 2000000, 3000000, 5000000 };
+	for (int i = 0; i < 3; i++)
+	{
+		bids.push_back(Order(100.0 - (i + 1) / 256., sizes[i], BID));
+		offers.push_back(Order(100.0 + i / 256., sizes[i], OFFER));
+	}
+	return OrderBook<Bond>(bond, bids, offers);
+}
+
+// Get the slice of a venue, nullptr when the route does not use it
+static const RouteSlice* FindSlice(const vector<RouteSlice> &slices, Market venue)
+{
+	for (int i = 0; i < slices.size(); i++)
+	{
+		if (slices[i].venue == venue) return &slices[i];
+	}
+	return nullptr;
+}
+
+static long RoutedQuantity(const vector<RouteSlice> &slices)
+{
+	long quantity = 0;
+	for (int i = 0; i < slices.size(); i++) quantity += slices[i].quantity;
+	return quantity;
+}
+
+// Without depth the whole order goes to the default venue
+static void TestDefaultVenue(SmartOrderRouter<Bond> &router)
+{
+	Bond bond = TestBond("NODEPTH");
+	ExecutionOrder<Bond> order(bond, BID, 1, LIMIT, 100.0, 3000000, 0, 0, false);
+	const vector<RouteSlice> &slices = router.Route(order);
+	CHECK(slices.size() == 1);
+	CHECK(!slices.empty() && slices[0].venue == CME && slices[0].quantity == 3000000);
+}
+
+// The fill model gives each venue its share of every level, and the router takes the cheapest
+// depth first: all three touches, then the cheapest venue's second level
+static void TestSplit(SmartOrderRouter<Bond> &router, VenueFillModel<Bond> &model)
+{
+	Bond bond = TestBond("SPLIT");
+	model.UpdateDepth(TestBook(bond));
+	int32_t limitTicks = 25600 + 1;
+	ExecutionOrder<Bond> order(bond, BID, 2, LIMIT, limitTicks / 256., 4000000, 0, 0, false);
+	const vector<RouteSlice> &slices = router.Route(order);
+	CHECK(slices.size() == 3);
+	CHECK(RoutedQuantity(slices) == 4000000);
+	const RouteSlice *brokertec = FindSlice(slices, BROKERTEC);
+	const RouteSlice *espeed = FindSlice(slices, ESPEED);
+	const RouteSlice *cme = FindSlice(slices, CME);
+	CHECK(brokertec != nullptr && brokertec->quantity == 2500000 && brokertec->limitTicks == limitTicks);
+	CHECK(espeed != nullptr && espeed->quantity == 1100000 && espeed->limitTicks == limitTicks);
+	CHECK(cme != nullptr && cme->quantity == 400000 && cme->limitTicks == 25600);
+	for (int i = 0; i < slices.size(); i++) CHECK(slices[i].limitTicks <= limitTicks);
+
+	// depth taken is not chased again before the next book: only eSpeed and CME depth is left
+	ExecutionOrder<Bond> next(bond, BID, 3, LIMIT, limitTicks / 256., 4000000, 0, 0, false);
+	const vector<RouteSlice> &after = router.Route(next);
+	CHECK(RoutedQuantity(after) == 4000000);
+	CHECK(FindSlice(after, BROKERTEC) == nullptr);
+	CHECK(FindSlice(after, CME) != nullptr && FindSlice(after, CME)->quantity == 600000);
+}
+
+// Under the fill model the routed order costs less than sending it whole to any one venue
+static void TestExpectedCost(SmartOrderRouter<Bond> &router, VenueFillModel<Bond> &model)
+{
+	Bond bond = TestBond("COST");
+	PricingSide sides[2] = { BID, OFFER };
+	for (int s = 0; s < 2; s++)
+	{
+		for (long quantity = 1000000; quantity <= 10000000; quantity += 1000000)
+		{
+			model.UpdateDepth(TestBook(bond));
+			int32_t limitTicks = (sides[s] == BID ? 25602 : 25597);
+			ExecutionOrder<Bond> order(bond, sides[s], 4, LIMIT, limitTicks / 256., quantity, 0, 0, false);
+			vector<RouteSlice> slices = router.Route(order);
+			CHECK(RoutedQuantity(slices) == quantity);
+			double routed = model.ExpectedCost(order, slices);
+			for (int v = 0; v < 3; v++)
+			{
+				RouteSlice whole = { (Market)v, quantity, limitTicks, 0 };
+				CHECK(routed <= model.ExpectedCost(order, vector<RouteSlice>(1, whole)) + 1e-9);
+			}
+		}
+	}
+}
+
+// A sell order trades against the bids, best first, and never below its limit
+static void TestSell(SmartOrderRouter<Bond> &router, VenueFillModel<Bond> &model)
+{
+	Bond bond = TestBond("SELL");
+	model.UpdateDepth(TestBook(bond));
+	ExecutionOrder<Bond> order(bond, OFFER, 5, LIMIT, 25599 / 256., 1000000, 0, 0, false);
+	const vector<RouteSlice> &slices = router.Route(order);
+	CHECK(slices.size() == 1);
+	CHECK(!slices.empty() && slices[0].venue == BROKERTEC && slices[0].limitTicks == 25599);
+
+	// half the touch is on BrokerTec, so an order for all of it fills there only in expectation
+	VenueFill fill = model.ExpectedFill(order, slices[0]);
+	CHECK(fill.quantity > 0.95 * 1000000 && fill.quantity < 1000000);
+	RouteSlice missing = { BROKERTEC, 2000000, 25599, 0 };
+	CHECK(model.ExpectedFill(order, missing).quantity < 1000000);
+}
+
+int main()
+{
+	SmartOrderRouter<Bond> *router = SmartOrderRouter<Bond>::Generate_Instance();
+	VenueFillModel<Bond> *model = VenueFillModel<Bond>::Generate_Instance();
+
+	TestDefaultVenue(*router);
+	TestSplit(*router, *model);
+	TestExpectedCost(*router, *model);
+	TestSell(*router, *model);
+	return TestResult("smartorderrouter_test");
+}
@@ -0,0 +1,161 @@
+/**
+* snapshottable_test.cpp
+* Reader threads against a writer on the SeqLock, the SnapshotCell and the SnapshotTable directory.
+*
+* @author Chenghan Huang
+*/
+#include "seqlock.hpp"
+#include "snapshottable.hpp"
+#include "testing.hpp"
+#include <thread>
+#include <vector>
+
+static const int READERS = 3;
+static const long WRITES = 200000;
+static const int KEYS = 64;
+
+// A value whose halves are written together: second is always -first
+struct Pair
+{
+	long first;
+	long second;
+};
+
+// Start READERS threads running read until done is set
+template<typename Read>
+static vector<thread> StartReaders(atomic<bool> &done, Read read)
+{
+	vector<thread> readers;
+	for (int r = 0; r < READERS; r++)
+	{
+		readers.emplace_back([&done, read]()
+		{
+			while (!done.load()) read();
+		});
+	}
+	return readers;
+}
+
+static void StopReaders(atomic<bool> &done, vector<thread> &readers)
+{
+	done.store(true);
+	for (int r = 0; r < readers.size(); r++) readers[r].join();
+}
+
+// Readers never copy out a value torn by a write, and never see an older version after a newer one
+static void TestSeqLock()
+{
+	SeqLock<Pair> slot;
+	atomic<bool> done(false);
+	atomic<long> torn(0);
+	atomic<long> backwards(0);
+	vector<thread> readers = StartReaders(done, [&slot, &torn, &backwards]()
+	{
+		static thread_local uint64_t last = 0;
+		Pair value;
+		uint64_t version = slot.Load(value);
+		if (value.second != -value.first) torn++;
+		if (version < last) backwards++;
+		last = version;
+	});
+	for (long i = 1; i <= WRITES; i++)
+	{
+		Pair value = { i, -i };
+		slot.Store(value);
+	}
+	StopReaders(done, readers);
+
+	CHECK(torn.load() == 0);
+	CHECK(backwards.load() == 0);
+	Pair value;
+	CHECK(slot.Load(value) == (uint64_t)WRITES && value.first == WRITES);
+}
+
+// Readers copy out whole values while the writer swaps them in; once no reader is inside, the
+// replaced copies are reused rather than allocating on every write
+static void TestSnapshotCell()
+{
+	SnapshotCell<vector<long>> cell;
+	atomic<bool> done(false);
+	atomic<long> torn(0);
+	vector<thread> readers = StartReaders(done, [&cell, &torn]()
+	{
+		vector<long> value;
+		uint64_t version = cell.Load(value);
+		if (version == 0) return;
+		// the write of version v is v % 16 + 1 copies of v
+		if (value.size() != version % 16 + 1) torn++;
+		for (size_t i = 0; i < value.size(); i++)
+		{
+			if (value[i] != (long)version) torn++;
+		}
+	});
+	vector<long> value;
+	for (long i = 1; i <= WRITES; i++)
+	{
+		value.assign(i % 16 + 1, i);
+		cell.Store(value);
+	}
+	StopReaders(done, readers);
+	CHECK(torn.load() == 0);
+	CHECK(cell.GetVersion() == (uint64_t)WRITES);
+
+	// with the readers gone the first write frees every retired copy, and later ones reuse them
+	cell.Store(value);
+	size_t nodes = cell.GetNodeCount();
+	for (int i = 0; i < 1000; i++) cell.Store(value);
+	CHECK(cell.GetNodeCount() == nodes);
+}
+
+// Readers look keys up while the writer adds them: a key is either not found or found whole,
+// and once found is never lost
+static void TestSnapshotTable()
+{
+	SnapshotTable<int, Pair> table;
+	atomic<bool> done(false);
+	atomic<long> torn(0);
+	atomic<long> lost(0);
+	vector<thread> readers = StartReaders(done, [&table, &torn, &lost]()
+	{
+		static thread_local bool seen[KEYS] = {};
+		for (int key = 0; key < KEYS; key++)
+		{
+			Pair value;
+			if (!table.TryGet(key, value))
+			{
+				if (seen[key]) lost++;
+				continue;
+			}
+			seen[key] = true;
+			if (value.second != -value.first || value.first % KEYS != key) torn++;
+		}
+	});
+	for (long i = 0; i < WRITES; i++)
+	{
+		// one more key every WRITES / (2 * KEYS) writes, then updates of all of them
+		long keys = i / (WRITES / (2 * KEYS)) + 1;
+		int key = (int)(i % (keys < KEYS ? keys : KEYS));
+		Pair value = { i - i % KEYS + key, -(i - i % KEYS + key) };
+		table.Store(key, value);
+	}
+	StopReaders(done, readers);
+
+	CHECK(torn.load() == 0);
+	CHECK(lost.load() == 0);
+	CHECK(table.GetSize() == (size_t)KEYS);
+	for (int key = 0; key < KEYS; key++)
+	{
+		Pair value;
+		CHECK(table.TryGet(key, value) && value.first % KEYS == key);
+		CHECK(table.GetSlot(key) != nullptr);
+	}
+	CHECK(table.GetSlot(KEYS) == nullptr);
+}
+
+int main()
+{
+	TestSeqLock();
+	TestSnapshotCell();
+	TestSnapshotTable();
+	return TestResult("snapshottable_test");
+}
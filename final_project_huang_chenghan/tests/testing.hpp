@@ -0,0 +1,41 @@
+/**
+* testing.hpp
+* Minimal checks for the test executables: a failed CHECK is reported and the test carries on.
+*
+* @author Chenghan Huang
+*/
+#ifndef TESTING_HPP
+#define TESTING_HPP
+
+#include <iostream>
+
+// Get the number of failed checks so far
+inline int& TestFailures()
+{
+	static int failures = 0;
+	return failures;
+}
+
+#define CHECK(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed" << std::endl; \
+			TestFailures()++; \
+		} \
+	} while (0)
+
+// Report the outcome of a test executable; returns its exit code
+inline int TestResult(const char *name)
+{
+	if (TestFailures() == 0)
+	{
+		std::cout << name << ": passed" << std::endl;
+		return 0;
+	}
+	std::cerr << name << ": " << TestFailures() << " checks failed" << std::endl;
+	return 1;
+}
+
+#endif
@@ -0,0 +1,104 @@
+/**
+* timerwheel.hpp
+* Hashed timer wheel for scheduling work a number of ticks ahead.
+*
+* @author Chenghan Huang
+*/
+#ifndef TIMER_WHEEL_HPP
+#define TIMER_WHEEL_HPP
+
+#include <vector>
+#include <cstdint>
+
+using namespace std;
+
+/**
+* Hashed timer wheel. A timer due in d ticks goes into slot (now + d) mod size with
+* d / size full turns left to wait, so scheduling is O(1) and advancing one tick only
+* touches the timers hashed to that slot, however many timers are pending overall.
+* Type V is the payload handed back when a timer fires.
+*/
+template<typename V>
+class TimerWheel
+{
+
+public:
+
+	// ctor for a wheel with _size slots (rounded up to a power of two), each with room for
+	// _slotCapacity timers up front, so scheduling only allocates once a slot holds more
+	explicit TimerWheel(uint32_t _size = 256, uint32_t _slotCapacity = 4)
+	{
+		uint32_t size = 1;
+		while (size < _size) size <<= 1;
+		slots.resize(size);
+		for (uint32_t i = 0; i < size; i++) slots[i].reserve(_slotCapacity);
+		due.reserve(_slotCapacity);
+		mask = size - 1;
+		now = 0;
+		pending = 0;
+	}
+
+	// Schedule payload to fire after delay ticks (0 fires on the next Advance)
+	void Schedule(uint64_t delay, const V &payload)
+	{
+		uint64_t due = now + (delay > 0 ? delay : 1);
+		Entry entry;
+		entry.rounds = (due - now - 1) / slots.size();
+		entry.payload = payload;
+		slots[due & mask].push_back(entry);
+		pending++;
+	}
+
+	// Move one tick forward, calling fire(payload) for every timer that is due.
+	// fire may schedule new timers.
+	template<typename Fire>
+	void Advance(Fire fire)
+	{
+		now++;
+		vector<Entry> &slot = slots[now & mask];
+		if (slot.empty()) return;
+		due.swap(slot);
+		for (int i = 0; i < due.size(); i++)
+		{
+			if (due[i].rounds > 0)
+			{
+				due[i].rounds--;
+				slots[now & mask].push_back(due[i]);
+			}
+			else
+			{
+				pending--;
+				fire(due[i].payload);
+			}
+		}
+		due.clear();
+	}
+
+	// Get the current tick
+	uint64_t GetTick() const
+	{
+		return now;
+	}
+
+	// Get the number of timers not yet fired
+	uint64_t GetPending() const
+	{
+		return pending;
+	}
+
+private:
+	struct Entry
+	{
+		uint64_t rounds;
+		V payload;
+	};
+
+	vector<vector<Entry> > slots;
+	vector<Entry> due;      // scratch for the slot being fired, keeps its capacity
+	uint64_t mask;
+	uint64_t now;
+	uint64_t pending;
+
+};
+
+#endif
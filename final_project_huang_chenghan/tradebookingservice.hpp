@@ -15,8 +15,12 @@
 #include <fstream>
 #include <string>
 #include <map>
+#include <chrono>
 #include "soa.hpp"
 #include "products.hpp"
+#include "latencystats.hpp"
+#include "idgenerator.hpp"
+#include "arena.hpp"
 
  // Trade sides
 enum Side { BUY, SELL };
@@ -40,13 +44,13 @@ public:
 	Trade() {}
 
 	// ctor for a trade
-	Trade(const T &_product, string _tradeId, double _price, string _book, long _quantity, Side _side);
+	Trade(const T &_product, IdType _tradeId, double _price, string _book, long _quantity, Side _side);
 
 	// Get the product
 	const T& GetProduct() const;
 
 	// Get the trade ID
-	const string& GetTradeId() const;
+	IdType GetTradeId() const;
 
 	// Get the mid price
 	double GetPrice() const;
@@ -62,7 +66,9 @@ public:
 
 	friend ostream& operator << (ostream& os, const Trade<T>& t)
 	{
-		os << "Trade ID: " << t.GetTradeId() << endl;
+		char id[32];
+		IdGenerator::Render(t.GetTradeId(), id);
+		os << "Trade ID: " << id << endl;
 		os << "  Product: " << t.GetProduct() << endl;
 		os << "  Book: " << t.GetBook() << endl;
 		os << "  Price: " << t.GetPrice() << endl;
@@ -75,7 +81,7 @@ public:
 
 private:
 	T product;
-	string tradeId;
+	IdType tradeId;
 	double price;
 	string book;
 	long quantity;
@@ -93,8 +99,9 @@ class TradeBookingService : public Service<string, Trade <T> >
 {
 public:
 	Trade<T> trade;
-	map<string, Trade<T>> BookMap;
+	map<IdType, Trade<T>, less<IdType>, PoolAllocator<pair<const IdType, Trade<T>>>> BookMap;    // nodes from the trade pool
 	vector<ServiceListener<Trade<T>>*> ListenerList;
+	vector<Trade<T>*> BookedList;    // trades of the batch being booked, kept for reuse
 
 	TradeBookingService() {}
 
@@ -104,21 +111,32 @@ public:
 		return &instance;
 	}
 
-	// Book the trade
-	void BookTrade(const Trade<T> &data)
+	// Book the trade; false if its trade id was already booked
+	bool BookTrade(const Trade<T> &data)
 	{
-		string id = data.GetTradeId();
-		BookMap.insert(pair<string, Trade<T>>(id, data));
+		if (BookMap.find(data.GetTradeId()) != BookMap.end()) return false;
+		BookMap.emplace(data.GetTradeId(), data);
+		return true;
+	}
+
+	// Book a trade the caller is done with, moving it into BookMap; returns the booked trade,
+	// or nullptr if its trade id was already booked (data is then left as it was)
+	Trade<T>* BookTrade(Trade<T> &&data)
+	{
+		IdType id = data.GetTradeId();
+		if (BookMap.find(id) != BookMap.end()) return nullptr;
+		return &BookMap.emplace(id, std::move(data)).first->second;
 	}
 
 	virtual Trade<T>& GetData(string id)
 	{
-		return BookMap[id];
+		return BookMap.at(IdGenerator::Parse(id));
 	}
 
+	// Book a trade and hand it to the listeners; a trade id already booked is dropped
 	virtual void OnMessage(Trade<T> &data)
 	{
-		BookTrade(data);
+		if (!BookTrade(data)) return;
 		for (int i = 0; i < ListenerList.size(); i++)
 		{
 			ServiceListener<Trade<T>>* listener = ListenerList[i];
@@ -126,6 +144,36 @@ public:
 		}
 	}
 
+	// Book a trade the connector is done with, moved rather than copied into BookMap
+	virtual void OnMessage(Trade<T> &&data)
+	{
+		Trade<T> *booked = BookTrade(std::move(data));
+		if (booked == nullptr) return;
+		for (int i = 0; i < ListenerList.size(); i++)
+		{
+			ServiceListener<Trade<T>>* listener = ListenerList[i];
+			listener->ProcessAdd(*booked);
+		}
+	}
+
+	// Book a block of trades the caller is done with, moving each into BookMap, then hand the
+	// booked ones to each listener in order. Trades whose id was already booked are dropped.
+	virtual void OnMessageBatch(Trade<T> *data, size_t count)
+	{
+		BookedList.clear();
+		for (size_t i = 0; i < count; i++)
+		{
+			Trade<T> *booked = BookTrade(std::move(data[i]));
+			if (booked != nullptr) BookedList.push_back(booked);
+		}
+		if (BookedList.empty()) return;
+		for (int i = 0; i < ListenerList.size(); i++)
+		{
+			ServiceListener<Trade<T>>* listener = ListenerList[i];
+			listener->ProcessAddBatch(BookedList.data(), BookedList.size());
+		}
+	}
+
 	virtual void AddListener(ServiceListener<Trade<T>>* _listener)
 	{
 		ListenerList.push_back(_listener);
@@ -137,6 +185,86 @@ public:
 	}
 };
 
+/**
+* Batched hand-off of our own executions into the TradeBookingService.
+* Fills are queued with the time they happened and booked as one OnMessageBatch, which runs
+* them through the booking listeners into positions and risk, once batchSize have queued or
+* the oldest has waited maxAgeUs microseconds. The age is checked on every Push and on
+* FlushExpired, which the owner calls on its ticks so a lone fill is not held until the next.
+* The time from fill to updated position is recorded for every trade.
+* Type T is the product type.
+*/
+template<typename T>
+class TradeBookingQueue
+{
+public:
+
+	// ctor for a queue booking into _service in batches of _batchSize, holding a fill at most _maxAgeUs
+	TradeBookingQueue(TradeBookingService<T> *_service, size_t _batchSize, long _maxAgeUs)
+	{
+		service = _service;
+		batchSize = (_batchSize > 0 ? _batchSize : 1);
+		maxAge = std::chrono::microseconds(_maxAgeUs > 0 ? _maxAgeUs : 0);
+		TradeList.reserve(batchSize);
+		FilledList.reserve(batchSize);
+	}
+
+	// Queue a trade that has just been filled
+	void Push(const Trade<T> &_trade)
+	{
+		TradeList.push_back(_trade);
+		Queued();
+	}
+
+	// Queue a trade that has just been filled, moving it in
+	void Push(Trade<T> &&_trade)
+	{
+		TradeList.push_back(std::move(_trade));
+		Queued();
+	}
+
+	// Book the queued trades if the oldest has waited maxAgeUs
+	void FlushExpired()
+	{
+		if (!FilledList.empty() && std::chrono::steady_clock::now() - FilledList.front() >= maxAge) Flush();
+	}
+
+	// Book every queued trade
+	void Flush()
+	{
+		if (TradeList.empty()) return;
+		service->OnMessageBatch(TradeList.data(), TradeList.size());
+		std::chrono::steady_clock::time_point booked = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < FilledList.size(); i++)
+		{
+			latency.Record(std::chrono::duration_cast<std::chrono::nanoseconds>(booked - FilledList[i]).count());
+		}
+		TradeList.clear();
+		FilledList.clear();
+	}
+
+	// Get the fill to position latency
+	const LatencyStats& GetLatency() const
+	{
+		return latency;
+	}
+
+private:
+	TradeBookingService<T> *service;
+	size_t batchSize;
+	std::chrono::steady_clock::duration maxAge;
+	vector<Trade<T>> TradeList;                                 // queued trades
+	vector<std::chrono::steady_clock::time_point> FilledList;   // when each was filled
+
+	void Queued()
+	{
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		FilledList.push_back(now);
+		if (TradeList.size() >= batchSize || now - FilledList.front() >= maxAge) Flush();
+	}
+	LatencyStats latency;
+};
+
 template<typename T>
 class TradeBookingServiceListener : public ServiceListener<Trade<T>>
 {
@@ -152,6 +280,11 @@ public:
 		_bondPositionService->AddTrade(_trade);
 	}
 
+	void ProcessAddBatch(Trade<T> *const *_trades, size_t count)
+	{
+		_bondPositionService->AddTradeBatch(_trades, count);
+	}
+
 	void ProcessRemove(Trade<T> &data) {}
 	void ProcessUpdate(Trade<T> &data) {}
 
@@ -177,16 +310,21 @@ public:
 
 	void Publish(Trade<Bond> &data) {}
 
-	// reading from file and call service's OnMessage
+	// reading from file in blocks of BLOCK_SIZE trades and call service's OnMessageBatch
 	void Subscribe() {
 		/* some functions*/
-		auto SplitLine = [](std::string& line)
+		// split a row into fields held in the row's arena
+		auto SplitLine = [](const std::string& line, vector<std::string, ArenaAllocator<std::string>> &fields)
 		{
-			stringstream enter_line(line);
-			std::string item;
-			std::vector<std::string> tmp;
-			while (getline(enter_line, item, ',')) 	tmp.push_back(item);
-			return tmp;
+			fields.clear();
+			size_t start = 0, end;
+			while (start < line.size())
+			{
+				end = line.find(',', start);
+				if (end == std::string::npos) end = line.size();
+				fields.emplace_back(line, start, end - start);
+				start = end + 1;
+			}
 		};
 		auto String2Price = [](std::string& str)
 		{
@@ -203,42 +341,61 @@ public:
 		ifstream is("input/trades.txt");
 		string line;
 		string _cusip, _tradeId, _book, _price, _quantity, _side;
+		vector<Trade<Bond>> block;
+		block.reserve(BLOCK_SIZE);
 		getline(is, line); // skip the header
 		while (std::getline(is, line))
 		{
-			std::vector<std::string> elems = SplitLine(line);
+			// the row's fields live in the arena, given back at the end of the row
+			ArenaScope row;
+			vector<std::string, ArenaAllocator<std::string>> elems;
+			SplitLine(line, elems);
 			_cusip = elems[0]; _tradeId = elems[1]; _book = elems[2];
 			_price = elems[3]; _quantity = elems[4]; _side = elems[5];
-			Bond bond = _bondProductService->GetData(_cusip);
-			Trade<Bond> trade(bond, _tradeId, String2Price(_price), _book, std::stol(_quantity), (_side == "BUY" ? BUY : SELL));
-			_bondTradeBookingservice->OnMessage(trade);
+			const Bond &bond = _bondProductService->GetData(_cusip);
+			block.emplace_back(bond, IdGenerator::Parse(_tradeId), String2Price(_price), _book, std::stol(_quantity), (_side == "BUY" ? BUY : SELL));
+			messageCount++;
+			if (block.size() == BLOCK_SIZE)
+			{
+				_bondTradeBookingservice->OnMessageBatch(block.data(), block.size());
+				block.clear();
+			}
 		}
+		if (!block.empty()) _bondTradeBookingservice->OnMessageBatch(block.data(), block.size());
 		std::cout << "risk.txt Generated." << std::endl;
 	}
 
+	// Get the number of rows read so far
+	long GetMessageCount() const
+	{
+		return messageCount;
+	}
+
 	TradeBookingService<Bond>* GetService()
 	{
 		return _bondTradeBookingservice;
 	}
 
 private:
+	static const size_t BLOCK_SIZE = 1024;    // trades read before handing them on as one batch
 
 	TradeBookingConnector()
 	{
+		messageCount = 0;
 		_bondTradeBookingservice = TradeBookingService<Bond>::Generate_Instance();
 		_bondProductService = BondProductService::Generate_Instance();
 	}
 	TradeBookingService<Bond>* _bondTradeBookingservice;
 	BondProductService * _bondProductService;
+	long messageCount;
 };
 
 template<typename T>
-Trade<T>::Trade(const T &_product, string _tradeId, double _price, string _book, long _quantity, Side _side) :
-	product(_product)
+Trade<T>::Trade(const T &_product, IdType _tradeId, double _price, string _book, long _quantity, Side _side) :
+	product(_product), book(std::move(_book))
 {
 	tradeId = _tradeId;
 	price = _price;
-	book = _book;
 	quantity = _quantity;
 	side = _side;
 }
@@ -250,7 +407,7 @@ const T& Trade<T>::GetProduct() const
 }
 
 template<typename T>
-const string& Trade<T>::GetTradeId() const
+IdType Trade<T>::GetTradeId() const
 {
 	return tradeId;
 }
@@ -0,0 +1,181 @@
+/**
+* venuefillmodel.hpp
+* Simple per-venue fill model splitting the consolidated feed across BROKERTEC, ESPEED and CME.
+*
+* @author Chenghan Huang
+*/
+#ifndef VENUE_FILL_MODEL_HPP
+#define VENUE_FILL_MODEL_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cmath>
+#include <cstdint>
+#include "soa.hpp"
+#include "products.hpp"
+#include "marketdataservice.hpp"
+#include "executionservice.hpp"
+#include "smartorderrouter.hpp"
+
+using namespace std;
+
+/**
+* Expected outcome of a slice on its venue: the quantity expected to fill, and the expected
+* cost in ticks of the whole slice, missed units included.
+*/
+struct VenueFill
+{
+	double quantity;
+	double costTicks;
+};
+
+/**
+* Fill model of the three venues for when only one consolidated book is known.
+* Each venue shows a fixed share of every displayed level. An order reaching a venue after its
+* latency finds each level still there with probability exp(-latency / depthLifetimeMicros);
+* what it finds fills at the level's price, the rest and anything beyond the displayed depth
+* misses at missPenaltyTicks. Every unit sent pays the venue's fee and its latency at
+* adverseTicksPerMicro. Fees and latencies are the router's venue models, so the model costs
+* a route in the terms the router chose it in, but from the depth the venue really shows.
+* Type T is the product type.
+*/
+template<typename T>
+class VenueFillModel
+{
+public:
+	static VenueFillModel<T>* Generate_Instance()
+	{
+		static VenueFillModel<T> instance;
+		return &instance;
+	}
+
+	// Set the share of the consolidated depth a venue shows
+	void SetVenueShare(Market _venue, double _share)
+	{
+		shares[_venue] = _share;
+	}
+
+	// Get the share of the consolidated depth a venue shows
+	double GetVenueShare(Market _venue) const
+	{
+		return shares[_venue];
+	}
+
+	// Set the cost of latency, the lifetime of displayed depth and the penalty for a missed fill
+	void SetCostParameters(double _adverseTicksPerMicro, double _depthLifetimeMicros, double _missPenaltyTicks)
+	{
+		adverseTicksPerMicro = _adverseTicksPerMicro;
+		depthLifetimeMicros = _depthLifetimeMicros;
+		missPenaltyTicks = _missPenaltyTicks;
+	}
+
+	// Split a consolidated book into the depth of each venue, and give the router each venue's share
+	void UpdateDepth(const OrderBook<T> &_orderbook)
+	{
+		ProductDepth &depth = DepthMap[_orderbook.GetProduct().GetProductId()];
+		for (int v = 0; v < 3; v++)
+		{
+			Load(_orderbook.GetBidStack(), shares[v], depth.venues[v].bids);
+			Load(_orderbook.GetOfferStack(), shares[v], depth.venues[v].offers);
+			_bondSmartOrderRouter->UpdateDepth((Market)v, _orderbook, shares[v]);
+		}
+	}
+
+	// Get the expected fill of one slice of _order on the slice's venue
+	VenueFill ExpectedFill(const ExecutionOrder<T> &_order, const RouteSlice &_slice) const
+	{
+		VenueFill fill = { 0, 0 };
+		if (_slice.quantity <= 0) return fill;
+		PricingSide side = _order.GetSide();
+		bool anyPrice = (_order.GetOrderType() == MARKET);
+		const VenueModel &model = _bondSmartOrderRouter->GetVenueModel(_slice.venue);
+		double surviving = exp(-model.latencyMicros / depthLifetimeMicros);
+
+		long unmatched = _slice.quantity;
+		double missed = 0;
+		auto it = DepthMap.find(_order.GetProduct().GetProductId());
+		if (it != DepthMap.end())
+		{
+			const vector<Level> &levels = (side == BID ? it->second.venues[_slice.venue].offers : it->second.venues[_slice.venue].bids);
+			for (int i = 0; i < levels.size() && unmatched > 0; i++)
+			{
+				if (!anyPrice && (side == BID ? levels[i].priceTicks > _slice.limitTicks : levels[i].priceTicks < _slice.limitTicks)) continue;
+				long take = (levels[i].quantity < unmatched ? levels[i].quantity : unmatched);
+				double price = (side == BID ? levels[i].priceTicks : -levels[i].priceTicks);
+				unmatched -= take;
+				fill.quantity += take * surviving;
+				fill.costTicks += take * price;
+				missed += take * (1 - surviving);
+			}
+		}
+		// no depth left to meet the rest: it waits at its limit and misses
+		fill.costTicks += unmatched * (double)(side == BID ? _slice.limitTicks : -_slice.limitTicks);
+		missed += unmatched;
+		fill.costTicks += missed * missPenaltyTicks;
+		fill.costTicks += _slice.quantity * (model.feeTicks + model.latencyMicros * adverseTicksPerMicro);
+		return fill;
+	}
+
+	// Get the expected cost per unit in ticks of _order sent as _slices
+	double ExpectedCost(const ExecutionOrder<T> &_order, const vector<RouteSlice> &_slices) const
+	{
+		double cost = 0;
+		long quantity = 0;
+		for (int i = 0; i < _slices.size(); i++)
+		{
+			cost += ExpectedFill(_order, _slices[i]).costTicks;
+			quantity += _slices[i].quantity;
+		}
+		return (quantity > 0 ? cost / quantity : 0);
+	}
+
+private:
+	struct Level
+	{
+		int32_t priceTicks;
+		long quantity;
+	};
+
+	struct VenueDepth
+	{
+		vector<Level> bids;
+		vector<Level> offers;
+	};
+
+	struct ProductDepth
+	{
+		VenueDepth venues[3];    // per Market
+	};
+
+	double shares[3];
+	double adverseTicksPerMicro;
+	double depthLifetimeMicros;
+	double missPenaltyTicks;
+	map<string, ProductDepth> DepthMap;
+	SmartOrderRouter<T>* _bondSmartOrderRouter;
+
+	VenueFillModel()
+	{
+		_bondSmartOrderRouter = SmartOrderRouter<T>::Generate_Instance();
+		// most of the cash depth is on BrokerTec
+		shares[BROKERTEC] = 0.5;
+		shares[ESPEED] = 0.3;
+		shares[CME] = 0.2;
+		adverseTicksPerMicro = 0.0005;
+		depthLifetimeMicros = 2000;
+		missPenaltyTicks = 1;
+	}
+
+	static void Load(const vector<Order> &stack, double share, vector<Level> &levels)
+	{
+		levels.resize(stack.size());
+		for (int i = 0; i < stack.size(); i++)
+		{
+			levels[i].priceTicks = (int32_t)lround(stack[i].GetPrice() * TICKS_PER_POINT);
+			levels[i].quantity = llround(stack[i].GetQuantity() * share);
+		}
+	}
+};
+
+#endif